@@ -0,0 +1,208 @@
+#include "SceneGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+static double deg2rad(double deg) {
+    return deg * M_PI / 180.0;
+}
+
+
+SceneGenerator::SceneGenerator(const SceneConfig &config) :
+        m_config(config), m_elevations(ringElevations(config.rings)), m_objects(), m_distances(), m_poses(),
+        m_timestamp(1000000), m_random(config.seed), m_unit(0.0, 1.0) {
+    m_start.timestamp = m_timestamp;
+    m_start.x = 0;
+    m_start.y = 0;
+    m_start.heading = 0;
+
+    std::uniform_real_distribution<double> angle(0.0, 2.0 * M_PI);
+    for (uint32_t i = 0; i < m_config.vehicles; i++) {
+        addObject(angle, 8, 40, 1.8, 4.5, 1.5, 12);
+    }
+    for (uint32_t i = 0; i < m_config.pedestrians; i++) {
+        addObject(angle, 4, 25, 0.6, 0.6, 1.8, 1.5);
+    }
+    for (uint32_t i = 0; i < m_config.buildings; i++) {
+        addObject(angle, 25, 60, 8, 20, 12, 0);
+    }
+    for (uint32_t i = 0; i < m_config.parked; i++) {
+        addObject(angle, 6, 40, 1.8, 4.5, 1.5, 0);
+    }
+
+    m_distances.resize(m_config.columns * m_config.rings);
+    m_sweep.startAzimuth = 0;
+    m_sweep.endAzimuth = 360.0 * (m_config.columns - 1) / m_config.columns;
+    m_sweep.columns = m_config.columns;
+    m_sweep.distances = m_distances.data();
+    m_sweep.sensor = 0;
+}
+
+std::vector<double> SceneGenerator::ringElevations(uint32_t rings) {
+    std::vector<double> elevations(rings);
+    double lowest = -15, highest = 15;
+    if (rings == 32) {
+        lowest = -30.67;
+        highest = 10.67;
+    } else if (rings == 64) {
+        lowest = -24.9;
+        highest = 2.0;
+    }
+    for (uint32_t i = 0; i < rings; i++) {
+        elevations[i] = rings > 1 ? lowest + (highest - lowest) * i / (rings - 1) : 0;
+    }
+    return elevations;
+}
+
+void SceneGenerator::addObject(std::uniform_real_distribution<double> &angle, double minRange, double maxRange,
+                               double width, double length, double height, double speed) {
+    const double direction = angle(m_random);
+    const double range = minRange + (maxRange - minRange) * m_unit(m_random);
+    SceneObject object;
+    object.x = range * std::cos(direction);
+    object.y = range * std::sin(direction);
+    object.heading = angle(m_random);
+    object.speed = speed * m_unit(m_random);
+    object.width = width;
+    object.length = length;
+    object.height = height;
+    m_objects.push_back(object);
+}
+
+Pose SceneGenerator::poseAt(int64_t timestamp) const {
+    const double t = (timestamp - m_start.timestamp) / 1000000.0;
+    const double heading = deg2rad(m_start.heading);
+    const double yawRate = deg2rad(m_config.egoYawRate);
+    Pose pose;
+    pose.timestamp = timestamp;
+    // heading is clockwise from north (y), like the Applanix heading
+    if (std::fabs(yawRate) < 1e-9) {
+        pose.x = m_start.x + m_config.egoSpeed * t * std::sin(heading);
+        pose.y = m_start.y + m_config.egoSpeed * t * std::cos(heading);
+    } else {
+        pose.x = m_start.x + m_config.egoSpeed / yawRate * (std::cos(heading) - std::cos(heading + yawRate * t));
+        pose.y = m_start.y + m_config.egoSpeed / yawRate * (std::sin(heading + yawRate * t) - std::sin(heading));
+    }
+    pose.heading = std::fmod(std::fmod(m_start.heading + m_config.egoYawRate * t, 360.0) + 360.0, 360.0);
+    return pose;
+}
+
+double SceneGenerator::groundHeight(double /*x*/, double y) const {
+    return m_config.groundSlope * y;
+}
+
+double SceneGenerator::cast(const Pose &pose, double azimuth, double elevation) {
+    const double ox = pose.x;
+    const double oy = pose.y;
+    const double oz = groundHeight(pose.x, pose.y) + m_config.sensorHeight;
+    const double dx = std::cos(elevation) * std::sin(azimuth);
+    const double dy = std::cos(elevation) * std::cos(azimuth);
+    const double dz = std::sin(elevation);
+
+    double range = std::numeric_limits<double>::max();
+
+    const double denominator = dz - m_config.groundSlope * dy;
+    if (denominator < 0) {
+        const double t = (m_config.groundSlope * oy - oz) / denominator;
+        if (t > 0) {
+            range = t;
+        }
+    }
+
+    for (auto &object : m_objects) {
+        // ray in the frame of the box
+        const double c = std::cos(object.heading);
+        const double s = std::sin(object.heading);
+        const double bx = c * (ox - object.x) + s * (oy - object.y);
+        const double by = -s * (ox - object.x) + c * (oy - object.y);
+        const double bdx = c * dx + s * dy;
+        const double bdy = -s * dx + c * dy;
+
+        double enter = 0, leave = range;
+        const double origin[2] = {bx, by};
+        const double direction[2] = {bdx, bdy};
+        const double half[2] = {object.length / 2, object.width / 2};
+        bool hit = true;
+        for (int axis = 0; axis < 2 && hit; axis++) {
+            if (std::fabs(direction[axis]) < 1e-12) {
+                hit = std::fabs(origin[axis]) <= half[axis];
+            } else {
+                double t0 = (-half[axis] - origin[axis]) / direction[axis];
+                double t1 = (half[axis] - origin[axis]) / direction[axis];
+                if (t0 > t1) {
+                    std::swap(t0, t1);
+                }
+                enter = std::max(enter, t0);
+                leave = std::min(leave, t1);
+                hit = enter <= leave;
+            }
+        }
+        if (hit && enter > 0) {
+            const double z = oz + enter * dz;
+            const double ground = groundHeight(object.x, object.y);
+            if (z >= ground && z <= ground + object.height) {
+                range = enter;
+            }
+        }
+    }
+
+    if (m_config.clutter > 0 && m_unit(m_random) < m_config.clutter) {
+        range = std::min(range, 2.5 + 30.0 * m_unit(m_random));
+    }
+
+    if (range > m_config.maxRange) {
+        return 0;
+    }
+    return range;
+}
+
+const Sweep &SceneGenerator::next() {
+    const int64_t begin = m_timestamp;
+    const int64_t end = m_timestamp + m_config.sweepPeriod;
+    const double dt = m_config.sweepPeriod / 1000000.0;
+
+    for (auto &object : m_objects) {
+        object.x += object.speed * dt * std::cos(object.heading);
+        object.y += object.speed * dt * std::sin(object.heading);
+    }
+
+    m_poses.clear();
+    for (int64_t t = begin + 10000; t <= end; t += 10000) {
+        m_poses.push_back(poseAt(t));
+    }
+
+    const uint32_t columns = m_config.columns;
+    const uint32_t rings = m_config.rings;
+    for (uint32_t i = 0; i < columns; i++) {
+        // columns are evenly spread over the sweep, the last one at its end
+        const int64_t t = columns > 1 ? begin + m_config.sweepPeriod * i / (columns - 1) : end;
+        const Pose pose = poseAt(t);
+        const double azimuth = deg2rad(m_sweep.startAzimuth + (m_sweep.endAzimuth - m_sweep.startAzimuth) * i / std::max<uint32_t>(columns - 1, 1) +
+                                       pose.heading);
+        for (uint32_t ring = 0; ring < rings; ring++) {
+            const double range = cast(pose, azimuth, deg2rad(m_elevations[ring]));
+            m_distances[i * rings + ring] = static_cast<uint16_t>(std::min(std::round(range * 100.0), 65535.0));
+        }
+    }
+
+    m_timestamp = end;
+    m_sweep.timestamp = end;
+    return m_sweep;
+}
+
+const std::vector<Pose> &SceneGenerator::poses() const {
+    return m_poses;
+}
+
+const std::vector<SceneObject> &SceneGenerator::objects() const {
+    return m_objects;
+}
+
+const std::vector<uint16_t> &SceneGenerator::distances() const {
+    return m_distances;
+}
+
+uint32_t SceneGenerator::rings() const {
+    return m_config.rings;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "PointcloudPipeline.h"
+#include "PoseBuffer.h"
+
+struct SceneConfig {
+    // 16, 32 or 64
+    uint32_t rings = 16;
+    uint32_t columns = 1800;
+    // meters above the ground
+    double sensorHeight = 1.95;
+    // rise of the ground per meter northwards
+    double groundSlope = 0;
+    uint32_t vehicles = 4;
+    uint32_t pedestrians = 4;
+    // static boxes, 12 m tall
+    uint32_t buildings = 0;
+    // vehicles that do not move
+    uint32_t parked = 0;
+    // fraction of the rays that return from clutter, e.g. vegetation
+    double clutter = 0;
+    // meters per second
+    double egoSpeed = 0;
+    // degrees per second
+    double egoYawRate = 0;
+    double maxRange = 100;
+    // microseconds
+    int64_t sweepPeriod = 100000;
+    uint32_t seed = 1;
+};
+
+/**
+ * Box moving with constant speed along its heading.
+ */
+struct SceneObject {
+    double x;
+    double y;
+    // radians, counter clockwise from the x axis
+    double heading;
+    double speed;
+    double width;
+    double length;
+    double height;
+};
+
+/**
+ * Deterministic synthetic lidar scenes.
+ *
+ * Rays are cast against a sloped ground plane, vehicle and pedestrian boxes and random
+ * clutter. The ego vehicle moves during a sweep, every column is cast from the pose at
+ * its own time, so the output exercises the ego motion compensation as well. The same
+ * configuration always yields the same sequence of sweeps.
+ */
+class SceneGenerator {
+public:
+    explicit SceneGenerator(const SceneConfig &config);
+
+    /**
+     * Advances the scene by one sweep period and casts the next sweep.
+     *
+     * @return Valid until the next call.
+     */
+    const Sweep &next();
+
+    /**
+     * @return Ego poses at 100 Hz up to the end of the last sweep.
+     */
+    const std::vector<Pose> &poses() const;
+
+    const std::vector<SceneObject> &objects() const;
+
+    /**
+     * Distances in centimeters, rings() per column.
+     */
+    const std::vector<uint16_t> &distances() const;
+
+    uint32_t rings() const;
+
+    /**
+     * @return Elevation of every ring in degrees, lowest first.
+     */
+    static std::vector<double> ringElevations(uint32_t rings);
+
+private:
+    Pose poseAt(int64_t timestamp) const;
+
+    double groundHeight(double x, double y) const;
+
+    double cast(const Pose &pose, double azimuth, double elevation);
+
+    void addObject(std::uniform_real_distribution<double> &angle, double minRange, double maxRange,
+                   double width, double length, double height, double speed);
+
+    SceneConfig m_config;
+    std::vector<double> m_elevations;
+    std::vector<SceneObject> m_objects;
+    std::vector<uint16_t> m_distances;
+    std::vector<Pose> m_poses;
+    Pose m_start;
+    int64_t m_timestamp;
+    Sweep m_sweep;
+    std::mt19937 m_random;
+    std::uniform_real_distribution<double> m_unit;
+};
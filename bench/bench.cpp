@@ -0,0 +1,780 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SceneGenerator.h"
+#include "PointcloudPipeline.h"
+#include "StageTimer.h"
+#include "Logger.h"
+#include "dbscan.h"
+#include "Cluster.h"
+#include "Obstacle.h"
+#include "Kalman.h"
+#include "RoiMask.h"
+#include "SweepArchive.h"
+#include "StaticMap.h"
+#include "TaskScheduler.h"
+#include "FrameArena.h"
+#include "TrackIndex.h"
+
+using namespace std;
+
+/**
+ * Micro-benchmarks of the processing stages on synthetic scenes.
+ *
+ * Every table is a scaling curve: one row per problem size, median times in
+ * microseconds. The scenes are deterministic, so two builds can be compared row by row.
+ *
+ * Usage: pointcloud_cluster-bench [repetitions] [allocation ceiling]
+ *
+ * With a ceiling, the run fails if a frame after the warm-up allocates more often. It
+ * also fails if a decoded sweep differs from the encoded one or the track index answers
+ * a query differently from a linear scan.
+ */
+
+static uint32_t repetitions = 50;
+
+/**
+ * @return Median time of run() in microseconds; setup() runs before every repetition
+ * and is not measured.
+ */
+template<typename Setup, typename Run>
+static double median(Setup setup, Run run) {
+    vector<double> times;
+    for (uint32_t i = 0; i < repetitions; i++) {
+        setup();
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        run();
+        times.push_back(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count() / 1000.0);
+    }
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+static void feed(SceneGenerator &scene, PointcloudPipeline &pipeline) {
+    const Sweep &sweep = scene.next();
+    for (auto &pose : scene.poses()) {
+        pipeline.addPose(pose);
+    }
+    pipeline.process(sweep);
+}
+
+static double p50(Stage stage) {
+    return StageTimers::instance().histogram(stage).percentile(0.5) / 1000.0;
+}
+
+/**
+ * Runs whole sweeps and reads the per stage medians from the stage timers.
+ */
+static void benchStages(const char *title, const char *parameter, const vector<SceneConfig> &configs, const vector<double> &values) {
+    printf("\n%s\n", title);
+    printf("%10s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n", parameter, "points", "tracks", "decode", "ground", "plane", "cluster", "assoc",
+           "filter", "shape");
+    for (size_t n = 0; n < configs.size(); n++) {
+        double plane = 0;
+        {
+            SceneGenerator scene(configs[n]);
+            PointcloudPipeline pipeline;
+            pipeline.setGroundModel(GroundModel::Plane);
+            StageTimers::instance().reset();
+            for (uint32_t i = 0; i < repetitions; i++) {
+                feed(scene, pipeline);
+                StageTimers::instance().endFrame(0);
+            }
+            plane = p50(Stage::Ground);
+        }
+
+        SceneGenerator scene(configs[n]);
+        PointcloudPipeline pipeline;
+        StageTimers::instance().reset();
+        for (uint32_t i = 0; i < repetitions; i++) {
+            feed(scene, pipeline);
+            StageTimers::instance().endFrame(0);
+        }
+        printf("%10g %8u %8zu %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", values[n], pipeline.cloudSize() * 16, pipeline.obstacles().size(),
+               p50(Stage::Decode), p50(Stage::Ground), plane, p50(Stage::Cluster), p50(Stage::Associate), p50(Stage::Filter), p50(Stage::Shape));
+    }
+}
+
+static void benchPointCount() {
+    vector<SceneConfig> configs;
+    vector<double> values;
+    for (uint32_t columns : {250, 500, 1000, 1500, 2000}) {
+        SceneConfig config;
+        config.columns = columns;
+        config.clutter = 0.02;
+        configs.push_back(config);
+        values.push_back(columns);
+    }
+    benchStages("Stages against point count", "columns", configs, values);
+}
+
+static void benchTrackCount() {
+    vector<SceneConfig> configs;
+    vector<double> values;
+    for (uint32_t objects : {2, 8, 32, 64, 128}) {
+        SceneConfig config;
+        config.vehicles = objects / 2;
+        config.pedestrians = objects / 2;
+        config.egoSpeed = 10;
+        configs.push_back(config);
+        values.push_back(objects);
+    }
+    benchStages("Stages against object count", "objects", configs, values);
+}
+
+static void benchClutterStages() {
+    vector<SceneConfig> configs;
+    vector<double> values;
+    for (double clutter : {0.0, 0.1, 0.3}) {
+        SceneConfig config;
+        config.clutter = clutter;
+        config.egoSpeed = 10;
+        configs.push_back(config);
+        values.push_back(clutter);
+    }
+    benchStages("Stages against clutter, 10 m/s", "clutter", configs, values);
+}
+
+/**
+ * Feeds the sweep of the scene to every lidar, the primary one last, and books the
+ * time of the frame.
+ */
+static void feedSensors(SceneGenerator &scene, PointcloudPipeline &pipeline, uint32_t sensors) {
+    Sweep sweep = scene.next();
+    for (auto &pose : scene.poses()) {
+        pipeline.addPose(pose);
+    }
+    // the allocations of the generator are not part of the frame
+    StageTimers::instance().beginFrame();
+    // the primary lidar last, it triggers the frame
+    for (uint32_t n = sensors - 1; n > 0; n--) {
+        sweep.sensor = n;
+        pipeline.process(sweep);
+    }
+    sweep.sensor = 0;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    pipeline.process(sweep);
+    StageTimers::instance().endFrame(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count());
+}
+
+static void benchSensorCount() {
+    printf("\nFrame time against lidar count, every lidar sees the same scene\n");
+    printf("%10s %8s %10s %10s\n", "lidars", "clusters", "frame us", "stages us");
+    for (uint32_t sensors : {1, 2, 3, 4}) {
+        SceneConfig config;
+        config.clutter = 0.02;
+        SceneGenerator scene(config);
+        PointcloudPipeline pipeline;
+        pipeline.setSensors(vector<Extrinsics>(sensors));
+        StageTimers::instance().reset();
+        for (uint32_t i = 0; i < repetitions; i++) {
+            feedSensors(scene, pipeline, sensors);
+        }
+        const double stages = p50(Stage::Decode) + p50(Stage::Ground) + p50(Stage::Cluster) + p50(Stage::Associate);
+        printf("%10u %8zu %10.1f %10.1f\n", sensors, pipeline.clusters().size(),
+               StageTimers::instance().frameHistogram().percentile(0.5) / 1000.0, stages);
+    }
+}
+
+static void benchWorkers() {
+    const uint32_t defaultWorkers = TaskScheduler::instance().workerCount();
+    printf("\nFrame time against scheduler workers, %u cores\n", thread::hardware_concurrency());
+    printf("%10s %8s %10s %10s\n", "workers", "lidars", "frame us", "steals");
+    for (uint32_t workers : {0, 1, 3, 7}) {
+        TaskScheduler::instance().setWorkerCount(workers);
+        for (uint32_t sensors : {1, 4}) {
+            SceneConfig config;
+            config.clutter = 0.1;
+            config.parked = 16;
+            config.egoSpeed = 10;
+            SceneGenerator scene(config);
+            PointcloudPipeline pipeline;
+            pipeline.setSensors(vector<Extrinsics>(sensors));
+            StageTimers::instance().reset();
+            const uint64_t steals = TaskScheduler::instance().steals();
+            for (uint32_t i = 0; i < repetitions; i++) {
+                feedSensors(scene, pipeline, sensors);
+            }
+            printf("%10u %8u %10.1f %10.1f\n", workers, sensors, StageTimers::instance().frameHistogram().percentile(0.5) / 1000.0,
+                   static_cast<double>(TaskScheduler::instance().steals() - steals) / repetitions);
+        }
+    }
+    TaskScheduler::instance().setWorkerCount(defaultWorkers);
+}
+
+/**
+ * @param ceiling Allocations allowed per frame after the warm-up, 0 for no limit.
+ * @return False if a frame allocated more often than ceiling.
+ */
+static bool benchAllocations(uint64_t ceiling) {
+    static const uint32_t warmup = 20;
+    printf("\nHeap allocations per frame after %u frames, clutter 0.02, ego at 10 m/s\n", warmup);
+    printf("%10s %8s %8s %8s %8s %8s %8s %8s %8s %10s\n", "lidars", "decode", "ground", "preseg", "cluster", "assoc", "filter",
+           "shape", "other", "frame max");
+    bool withinCeiling = true;
+    for (uint32_t sensors : {1, 3}) {
+        SceneConfig config;
+        config.clutter = 0.02;
+        config.egoSpeed = 10;
+        SceneGenerator scene(config);
+        PointcloudPipeline pipeline;
+        pipeline.setSensors(vector<Extrinsics>(sensors));
+        for (uint32_t i = 0; i < warmup; i++) {
+            feedSensors(scene, pipeline, sensors);
+        }
+        StageTimers::instance().reset();
+        uint64_t worst = 0;
+        for (uint32_t i = 0; i < repetitions; i++) {
+            feedSensors(scene, pipeline, sensors);
+            worst = max(worst, StageTimers::instance().frameAllocations());
+        }
+        auto allocations = [](Stage stage) {
+            return static_cast<unsigned long long>(StageTimers::instance().allocationHistogram(stage).percentile(0.5));
+        };
+        printf("%10u %8llu %8llu %8llu %8llu %8llu %8llu %8llu %8llu %10llu\n", sensors, allocations(Stage::Decode),
+               allocations(Stage::Ground), allocations(Stage::Presegment), allocations(Stage::Cluster), allocations(Stage::Associate),
+               allocations(Stage::Filter), allocations(Stage::Shape), allocations(Stage::COUNT), static_cast<unsigned long long>(worst));
+        if (ceiling > 0 && worst > ceiling) {
+            printf("%u lidars: %llu allocations in a frame, the ceiling is %llu\n", sensors, static_cast<unsigned long long>(worst),
+                   static_cast<unsigned long long>(ceiling));
+            withinCeiling = false;
+        }
+    }
+    return withinCeiling;
+}
+
+static void benchCounters() {
+    printf("\nHardware counters per stage, 16 vehicles and pedestrians, clutter 0.1, 10 m/s\n");
+    if (!StageTimers::instance().setCountingEvents(true)) {
+        printf("not available\n");
+        return;
+    }
+    printf("%10s %8s %8s %8s %8s %8s %8s %8s\n", "stage", "us", "IPC", "IPC p1", "L1d/ki", "LLC/ki", "br/ki", "dTLB/ki");
+    SceneConfig config;
+    config.vehicles = 16;
+    config.pedestrians = 16;
+    config.clutter = 0.1;
+    config.egoSpeed = 10;
+    SceneGenerator scene(config);
+    PointcloudPipeline pipeline;
+    StageTimers::instance().reset();
+    for (uint32_t i = 0; i < repetitions; i++) {
+        feed(scene, pipeline);
+        StageTimers::instance().endFrame(0);
+    }
+    StageTimers::instance().setCountingEvents(false);
+    const StageTimers &timers = StageTimers::instance();
+    for (Stage stage : {Stage::Decode, Stage::Ground, Stage::Cluster, Stage::Associate, Stage::Filter, Stage::Shape}) {
+        const double instructions = timers.totalEvents(stage, PerfEvent::Instructions);
+        // n/a for the events the CPU does not offer
+        auto perKilo = [&](PerfEvent event) {
+            char column[16];
+            if (!timers.countsEvent(event)) {
+                return string("n/a");
+            }
+            snprintf(column, sizeof(column), "%.2f", instructions > 0 ? timers.totalEvents(stage, event) * 1000 / instructions : 0.0);
+            return string(column);
+        };
+        const double cycles = timers.totalEvents(stage, PerfEvent::Cycles);
+        printf("%10s %8.1f %8.2f %8.2f %8s %8s %8s %8s\n", stageName(stage), p50(stage), cycles > 0 ? instructions / cycles : 0.0,
+               timers.ipcHistogram(stage).percentile(0.01) / 1000.0, perKilo(PerfEvent::L1Misses).c_str(), perKilo(PerfEvent::LlcMisses).c_str(),
+               perKilo(PerfEvent::BranchMisses).c_str(), perKilo(PerfEvent::DtlbMisses).c_str());
+    }
+}
+
+static void benchGrid() {
+    printf("\nOccupancyGrid against grid size, ego at 10 m/s\n");
+    printf("%10s %10s %10s\n", "cells", "meters", "us");
+    for (uint32_t size : {256, 512, 1024}) {
+        SceneConfig config;
+        config.egoSpeed = 10;
+        SceneGenerator scene(config);
+        PointcloudPipeline pipeline;
+        pipeline.setOccupancyGrid(size, 0.2f);
+        StageTimers::instance().reset();
+        for (uint32_t i = 0; i < repetitions; i++) {
+            feed(scene, pipeline);
+            StageTimers::instance().endFrame(0);
+        }
+        printf("%10u %10.1f %10.1f\n", size, size * 0.2, p50(Stage::Grid));
+    }
+}
+
+static void benchRoi() {
+    printf("\nRegion of interest, 12 m wide road along y, clutter 0.1\n");
+    printf("%10s %8s %10s %10s\n", "mask", "clusters", "ground us", "cluster us");
+    for (int masked = 0; masked < 2; masked++) {
+        SceneConfig config;
+        config.clutter = 0.1;
+        config.egoSpeed = 10;
+        SceneGenerator scene(config);
+        PointcloudPipeline pipeline;
+        if (masked) {
+            std::shared_ptr<RoiMask> mask(new RoiMask(-100, -100, 100, 1000, 0.5f));
+            mask->addSegment(0, -100, 0, 1000, 6);
+            pipeline.setRoiMask(mask);
+        }
+        StageTimers::instance().reset();
+        for (uint32_t i = 0; i < repetitions; i++) {
+            feed(scene, pipeline);
+            StageTimers::instance().endFrame(0);
+        }
+        printf("%10s %8zu %10.1f %10.1f\n", masked ? "road" : "none", pipeline.clusters().size(), p50(Stage::Ground), p50(Stage::Cluster));
+    }
+}
+
+static void benchGuided() {
+    printf("\nTrack-guided segmentation against object count, after 20 frames\n");
+    printf("%10s %8s %10s %12s %10s\n", "objects", "guided", "tracks", "presegment us", "cluster us");
+    for (uint32_t objects : {4, 16, 48}) {
+        for (int guided = 0; guided < 2; guided++) {
+            SceneConfig config;
+            config.vehicles = objects / 2;
+            config.pedestrians = objects / 2;
+            SceneGenerator scene(config);
+            PointcloudPipeline pipeline;
+            pipeline.setGuidedSegmentation(guided != 0);
+            for (int i = 0; i < 20; i++) {
+                feed(scene, pipeline);
+            }
+            StageTimers::instance().reset();
+            for (uint32_t i = 0; i < repetitions; i++) {
+                feed(scene, pipeline);
+                StageTimers::instance().endFrame(0);
+            }
+            vector<ObstacleRecord> tracks;
+            pipeline.confirmedTracks(tracks);
+            printf("%10u %8s %10zu %12.1f %10.1f\n", objects, guided ? "yes" : "no", tracks.size(), p50(Stage::Presegment), p50(Stage::Cluster));
+        }
+    }
+}
+
+static void benchStaticMap() {
+    printf("\nStatic map against building count, learned over 30 frames\n");
+    printf("%10s %8s %10s %10s %10s\n", "buildings", "map", "clusters", "ground us", "cluster us");
+    for (uint32_t buildings : {2, 8}) {
+        for (int mapped = 0; mapped < 2; mapped++) {
+            SceneConfig config;
+            config.buildings = buildings;
+            SceneGenerator scene(config);
+            PointcloudPipeline pipeline;
+            std::shared_ptr<StaticMap> map = std::make_shared<StaticMap>();
+            if (mapped) {
+                pipeline.setStaticMap(map, true);
+            }
+            for (int i = 0; i < 30; i++) {
+                feed(scene, pipeline);
+            }
+            if (mapped) {
+                pipeline.setStaticMap(map, false);
+            }
+            StageTimers::instance().reset();
+            for (uint32_t i = 0; i < repetitions; i++) {
+                feed(scene, pipeline);
+                StageTimers::instance().endFrame(0);
+            }
+            printf("%10u %8s %10zu %10.1f %10.1f\n", buildings, mapped ? "yes" : "no", pipeline.clusters().size(), p50(Stage::Ground), p50(Stage::Cluster));
+        }
+    }
+}
+
+static void benchHibernation() {
+    printf("\nHibernation against parked vehicles, 4 moving vehicles and 4 pedestrians, after 20 frames\n");
+    printf("%10s %8s %8s %10s %12s %10s %10s\n", "parked", "ego m/s", "hibernate", "tracks", "hibernating", "filter us", "shape us");
+    for (uint32_t parked : {8, 32}) {
+        for (double speed : {0.0, 5.0}) {
+            for (int hibernate = 0; hibernate < 2; hibernate++) {
+                SceneConfig config;
+                config.parked = parked;
+                config.egoSpeed = speed;
+                SceneGenerator scene(config);
+                PointcloudPipeline pipeline;
+                pipeline.setHibernation(hibernate != 0);
+                for (int i = 0; i < 20; i++) {
+                    feed(scene, pipeline);
+                }
+                StageTimers::instance().reset();
+                uint32_t hibernating = 0;
+                for (uint32_t i = 0; i < repetitions; i++) {
+                    feed(scene, pipeline);
+                    StageTimers::instance().endFrame(0);
+                    for (auto &obst : pipeline.obstacles()) {
+                        hibernating += obst.m_hibernating;
+                    }
+                }
+                vector<ObstacleRecord> tracks;
+                pipeline.confirmedTracks(tracks);
+                printf("%10u %8.0f %8s %10zu %12.1f %10.1f %10.1f\n", parked, speed, hibernate ? "yes" : "no", tracks.size(),
+                       static_cast<double>(hibernating) / repetitions, p50(Stage::Filter), p50(Stage::Shape));
+            }
+        }
+    }
+}
+
+static void benchClutter() {
+    FrameArena arena(HugePages::PAGE_SIZE);
+    printf("\nDbScan::getClusters against clutter, heap and FrameArena (%s)\n", arena.hugePages() ? "huge pages" : "transparent huge pages");
+    printf("%10s %8s %8s %10s %10s %10s\n", "clutter", "points", "clusters", "heap us", "arena us", "arena KiB");
+    static Point snapshot[2000][16];
+    static Point points[2000][16];
+    for (double clutter : {0.0, 0.02, 0.05, 0.1, 0.2}) {
+        SceneConfig config;
+        config.clutter = clutter;
+        SceneGenerator scene(config);
+        PointcloudPipeline pipeline;
+        feed(scene, pipeline);
+
+        const uint32_t cloudSize = pipeline.cloudSize();
+        uint32_t candidates = 0;
+        for (uint32_t i = 0; i < cloudSize; i++) {
+            for (uint32_t j = 0; j < 16; j++) {
+                // undo the clustering, keep the ground segmentation
+                snapshot[i][j] = pipeline.points()[i][j];
+                snapshot[i][j].setVisited(snapshot[i][j].isGround());
+                snapshot[i][j].setClustered(snapshot[i][j].isGround());
+                candidates += snapshot[i][j].isGround() ? 0 : 1;
+            }
+        }
+
+        vector<Cluster> clusters;
+        double us = median([&]() {
+            copy(&snapshot[0][0], &snapshot[0][0] + 2000 * 16, &points[0][0]);
+            clusters.clear();
+        }, [&]() {
+            DbScan dbScan(points, cloudSize);
+            dbScan.getClusters(clusters);
+        });
+        double arenaUs = median([&]() {
+            copy(&snapshot[0][0], &snapshot[0][0] + 2000 * 16, &points[0][0]);
+            clusters.clear();
+            arena.reset();
+        }, [&]() {
+            DbScan dbScan(points, cloudSize);
+            dbScan.setArena(&arena);
+            dbScan.getClusters(clusters);
+        });
+        printf("%10g %8u %8zu %10.1f %10.1f %10zu\n", clutter, candidates, clusters.size(), us, arenaUs, arena.peak() / 1024);
+    }
+}
+
+static void benchShape() {
+    printf("\nCluster::getHull and calcRectangle against cluster size\n");
+    printf("%10s %8s %10s %10s\n", "points", "hull", "hull us", "rect us");
+    mt19937 random(1);
+    uniform_real_distribution<float> length(-2.25f, 2.25f);
+    uniform_real_distribution<float> width(-0.9f, 0.9f);
+    for (uint32_t size : {16, 64, 256, 1024, 4096}) {
+        vector<Point> points;
+        const float c = cos(0.3f), s = sin(0.3f);
+        for (uint32_t i = 0; i < size; i++) {
+            const float u = length(random), v = width(random);
+            points.push_back(Point(10 + c * u - s * v, 5 + s * u + c * v, 0, 0, 0));
+        }
+        Cluster cluster;
+        for (auto &point : points) {
+            cluster.m_cluster.push_back(&point);
+        }
+
+        double hull = median([&]() {
+            cluster.m_hull.clear();
+        }, [&]() {
+            cluster.getHull();
+        });
+        double rect = median([&]() {
+            cluster.m_hull.clear();
+        }, [&]() {
+            cluster.calcRectangle();
+        });
+        printf("%10u %8zu %10.2f %10.2f\n", size, cluster.getHull().size(), hull, rect);
+    }
+}
+
+static void benchRefresh() {
+    printf("\nLidarObstacle::refresh against track count\n");
+    printf("%10s %10s %12s\n", "tracks", "us", "us/track");
+    mt19937 random(1);
+    uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    for (uint32_t tracks : {8, 32, 128, 512}) {
+        // 50 points per track, spread over a grid
+        vector<Point> points;
+        points.reserve(tracks * 50);
+        vector<Cluster> clusters(tracks);
+        for (uint32_t n = 0; n < tracks; n++) {
+            const float x = 10.0f * (n % 32), y = 10.0f * (n / 32);
+            for (uint32_t i = 0; i < 50; i++) {
+                points.push_back(Point(x + 2 * offset(random), y + offset(random), offset(random), 0, 0));
+            }
+        }
+        for (uint32_t n = 0; n < tracks; n++) {
+            for (uint32_t i = 0; i < 50; i++) {
+                clusters[n].m_cluster.push_back(&points[n * 50 + i]);
+            }
+            clusters[n].mean();
+        }
+        list<LidarObstacle> obstacles;
+        for (uint32_t n = 0; n < tracks; n++) {
+            obstacles.push_back(LidarObstacle(&clusters[n], 0, n));
+        }
+
+        int64_t timestamp = 0;
+        double us = median([&]() {
+            timestamp += 100000;
+            uint32_t n = 0;
+            for (auto &obst : obstacles) {
+                obst.clusterCandidates.push_back(&clusters[n++]);
+            }
+        }, [&]() {
+            for (auto &obst : obstacles) {
+                obst.refresh(0, 0, timestamp, 0);
+            }
+        });
+        printf("%10u %10.1f %12.2f\n", tracks, us, us / tracks);
+    }
+}
+
+static void benchKalman() {
+    static const uint32_t calls = 100000;
+    printf("\nKalman\n");
+    printf("%10s %10s\n", "step", "ns/call");
+    Kalman filter;
+    filter.init(0, 0, 0, 5, 0.1);
+    double predict = median([]() {}, [&]() {
+        for (uint32_t i = 0; i < calls; i++) {
+            filter.predict(0.1);
+        }
+    });
+    filter.init(0, 0, 0, 5, 0.1);
+    double update = median([]() {}, [&]() {
+        for (uint32_t i = 0; i < calls; i++) {
+            filter.update(0.5 * i, 0.1 * i, 0.2, 5, 0.1, 0, 0);
+        }
+    });
+    printf("%10s %10.1f\n%10s %10.1f\n", "predict", predict * 1000 / calls, "update", update * 1000 / calls);
+}
+
+static bool benchArchive() {
+    bool matches = true;
+    printf("\nRangeCodec against clutter, 10 m/s\n");
+    printf("%10s %10s %10s %8s %10s %10s\n", "clutter", "raw bytes", "bytes", "ratio", "encode us", "decode us");
+    for (double clutter : {0.0, 0.1, 0.3}) {
+        SceneConfig config;
+        config.columns = 2000;
+        config.clutter = clutter;
+        config.egoSpeed = 10;
+        SceneGenerator scene(config);
+        const Sweep &sweep = scene.next();
+        string encoded;
+        double encode = median([&]() { encoded.clear(); }, [&]() {
+            RangeCodec::encode(sweep.distances, sweep.columns, 16, encoded);
+        });
+        vector<uint16_t> decoded(sweep.columns * 16);
+        double decode = median([]() {}, [&]() {
+            RangeCodec::decode(encoded.data(), encoded.size(), sweep.columns, 16, decoded.data());
+        });
+        if (!equal(decoded.begin(), decoded.end(), sweep.distances)) {
+            printf("decoded sweep differs\n");
+            matches = false;
+        }
+        const size_t raw = sweep.columns * 16 * sizeof(uint16_t);
+        printf("%10.1f %10zu %10zu %8.2f %10.1f %10.1f\n", clutter, raw, encoded.size(), static_cast<double>(raw) / encoded.size(), encode, decode);
+    }
+    return matches;
+}
+
+// Compares every query of the index with a linear scan, with tracks and queries well
+// beyond the 128 m grid and on its edges
+static bool checkTrackIndex(uint32_t tracks) {
+    mt19937 random(tracks);
+    uniform_real_distribution<float> position(-200, 200);
+    uniform_real_distribution<float> heading(0, 360);
+    vector<float> xs(tracks), ys(tracks);
+    TrackIndex index;
+    for (uint32_t i = 0; i < tracks; i++) {
+        xs[i] = position(random);
+        ys[i] = position(random);
+        index.add(i, xs[i], ys[i]);
+    }
+    index.build();
+
+    vector<float> qx, qy;
+    for (float edge : {-1000.0f, -200.0f, -128.0f, -127.9f, -124.0f, 0.0f, 124.0f, 127.9f, 128.0f, 200.0f, 1000.0f}) {
+        qx.push_back(edge);
+        qy.push_back(position(random));
+        qx.push_back(position(random));
+        qy.push_back(edge);
+        qx.push_back(edge);
+        qy.push_back(edge);
+    }
+    for (uint32_t q = 0; q < 200; q++) {
+        qx.push_back(position(random));
+        qy.push_back(position(random));
+    }
+
+    vector<uint32_t> ids, expected;
+    vector<pair<float, uint32_t> > distances(tracks);
+    for (size_t q = 0; q < qx.size(); q++) {
+        for (float r : {3.0f, 30.0f}) {
+            index.radius(qx[q], qy[q], r, ids);
+            expected.clear();
+            for (uint32_t i = 0; i < tracks; i++) {
+                const float dx = xs[i] - qx[q];
+                const float dy = ys[i] - qy[q];
+                if (dx * dx + dy * dy < r * r) {
+                    expected.push_back(i);
+                }
+            }
+            if (ids != expected) {
+                printf("radius %.0f at %.1f, %.1f: index and scan differ\n", r, qx[q], qy[q]);
+                return false;
+            }
+        }
+
+        const float h = heading(random);
+        const float s = static_cast<float>(sin(utils::deg2rad(h)));
+        const float c = static_cast<float>(cos(utils::deg2rad(h)));
+        index.corridor(qx[q], qy[q], h, 40, 2, ids);
+        expected.clear();
+        for (uint32_t i = 0; i < tracks; i++) {
+            const float dx = xs[i] - qx[q];
+            const float dy = ys[i] - qy[q];
+            const float along = dx * s + dy * c;
+            const float across = dx * c - dy * s;
+            if (along >= 0 && along <= 40 && fabs(across) <= 2) {
+                expected.push_back(i);
+            }
+        }
+        if (ids != expected) {
+            printf("corridor at %.1f, %.1f: index and scan differ\n", qx[q], qy[q]);
+            return false;
+        }
+
+        for (uint32_t i = 0; i < tracks; i++) {
+            const float dx = xs[i] - qx[q];
+            const float dy = ys[i] - qy[q];
+            distances[i] = make_pair(dx * dx + dy * dy, i);
+        }
+        sort(distances.begin(), distances.end());
+        index.nearest(qx[q], qy[q], 5, ids);
+        expected.clear();
+        for (uint32_t i = 0; i < min<uint32_t>(5, tracks); i++) {
+            expected.push_back(distances[i].second);
+        }
+        if (ids != expected) {
+            printf("nearest at %.1f, %.1f: index and scan differ\n", qx[q], qy[q]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool benchTrackIndex() {
+    static const uint32_t queries = 1000;
+    printf("\nTrackIndex against track count, %u radius queries of 3 m\n", queries);
+    printf("%10s %10s %10s %10s %10s\n", "tracks", "build us", "index us", "scan us", "nearest us");
+    bool matches = true;
+    for (uint32_t tracks : {64, 256, 1024, 4096}) {
+        mt19937 random(tracks);
+        uniform_real_distribution<float> position(-100, 100);
+        vector<float> xs(tracks), ys(tracks);
+        TrackIndex index;
+        for (uint32_t i = 0; i < tracks; i++) {
+            xs[i] = position(random);
+            ys[i] = position(random);
+        }
+        double build = median([&]() { index.clear(); }, [&]() {
+            for (uint32_t i = 0; i < tracks; i++) {
+                index.add(i, xs[i], ys[i]);
+            }
+            index.build();
+        });
+        vector<float> qx(queries), qy(queries);
+        for (uint32_t q = 0; q < queries; q++) {
+            qx[q] = position(random);
+            qy[q] = position(random);
+        }
+        vector<uint32_t> ids;
+        uint64_t found = 0, scanned = 0;
+        double indexed = median([&]() { found = 0; }, [&]() {
+            for (uint32_t q = 0; q < queries; q++) {
+                index.radius(qx[q], qy[q], 3, ids);
+                found += ids.size();
+            }
+        });
+        double scan = median([&]() { scanned = 0; }, [&]() {
+            for (uint32_t q = 0; q < queries; q++) {
+                ids.clear();
+                for (uint32_t i = 0; i < tracks; i++) {
+                    const float dx = xs[i] - qx[q];
+                    const float dy = ys[i] - qy[q];
+                    if (dx * dx + dy * dy < 9) {
+                        ids.push_back(i);
+                    }
+                }
+                scanned += ids.size();
+            }
+        });
+        double nearest = median([]() {}, [&]() {
+            for (uint32_t q = 0; q < queries; q++) {
+                index.nearest(qx[q], qy[q], 5, ids);
+            }
+        });
+        printf("%10u %10.1f %10.1f %10.1f %10.1f\n", tracks, build, indexed, scan, nearest);
+        if (found != scanned || !checkTrackIndex(tracks)) {
+            matches = false;
+        }
+    }
+    return matches;
+}
+
+static void benchGenerator() {
+    printf("\nSceneGenerator against ring count\n");
+    printf("%10s %10s %10s\n", "rings", "points", "us");
+    for (uint32_t rings : {16, 32, 64}) {
+        SceneConfig config;
+        config.rings = rings;
+        SceneGenerator scene(config);
+        double us = median([]() {}, [&]() {
+            scene.next();
+        });
+        printf("%10u %10zu %10.1f\n", rings, scene.distances().size(), us);
+    }
+}
+
+int32_t main(int32_t argc, char **argv) {
+    if (argc > 1) {
+        repetitions = max(1, stoi(argv[1]));
+    }
+    const uint64_t allocationCeiling = argc > 2 ? stoull(argv[2]) : 0;
+    Logger::instance().setLevel(LogLevel::Warning);
+
+    benchPointCount();
+    benchTrackCount();
+    benchClutterStages();
+    benchSensorCount();
+    benchWorkers();
+    const bool withinCeiling = benchAllocations(allocationCeiling);
+    benchCounters();
+    benchGrid();
+    benchRoi();
+    benchGuided();
+    benchStaticMap();
+    benchHibernation();
+    benchClutter();
+    benchShape();
+    benchRefresh();
+    benchKalman();
+    const bool archiveMatches = benchArchive();
+    const bool indexMatches = benchTrackIndex();
+    benchGenerator();
+
+    Logger::instance().flush();
+    return withinCeiling && archiveMatches && indexMatches ? 0 : 1;
+}
@@ -2,7 +2,11 @@
 
 #include <vector>
 #include "Point.h"
-#include <opencv2/imgproc/imgproc.hpp>
+#include "FrameArena.h"
+#include <eigen3/Eigen/Dense>
+
+// points of a cluster, from the FrameArena of the frame that found them
+typedef std::vector<Point *, ArenaAllocator<Point *>> PointList;
 
 class Cluster {
 private:
@@ -11,13 +15,15 @@ private:
 public:
     Cluster();
 
+    explicit Cluster(const ArenaAllocator<Point *> &allocator);
+
 
     std::vector<Point *> m_hull;
 
     double m_center[3];
     bool assigned;
-    std::vector<Point *> m_cluster;
-    cv::Point2f m_rectangle[4];
+    PointList m_cluster;
+    Eigen::Vector2f m_rectangle[4];
 
     void mean();
     void meanRect();
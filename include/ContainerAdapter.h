@@ -0,0 +1,44 @@
+#pragma once
+
+#include "opendavinci/odcore/data/Container.h"
+#include "opendlv/data/environment/WGS84Coordinate.h"
+#include "PointcloudPipeline.h"
+#include "PoseBuffer.h"
+#include <algorithm>
+#include <vector>
+
+/**
+ * Feeds the containers of a conference or a recording into a PointcloudPipeline.
+ *
+ * Poses are projected from WGS84 into the cartesian frame around the origin, sweeps are
+ * deserialized into plain distance arrays. Other containers are ignored.
+ */
+class ContainerAdapter {
+public:
+    ContainerAdapter();
+
+    /**
+     * @param lat Latitude of the origin of the cartesian frame.
+     * @param lon Longitude of the origin of the cartesian frame.
+     */
+    void setOrigin(double lat, double lon);
+
+    /**
+     * Maps the sender stamps of the lidars to the sensor indices of the pipeline, in
+     * the same order. Without stamps every sweep is taken from the primary lidar.
+     */
+    void setSensors(const std::vector<uint32_t> &senderStamps);
+
+    /**
+     * @return True if c completed a frame and the pipeline has processed it.
+     */
+    bool feed(odcore::data::Container &c, PointcloudPipeline &pipeline);
+
+private:
+    void anchorProjection(double lat, double lon);
+
+    opendlv::data::environment::WGS84Coordinate m_origin;
+    LocalProjection m_projection;
+    std::vector<uint32_t> m_senderStamps;
+    std::string m_distances;
+};
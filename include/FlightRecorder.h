@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "PoseBuffer.h"
+#include "SensorFrontEnd.h"
+
+/**
+ * Layout of a flight record file.
+ *
+ * The file starts with this header on its own page, followed by capacity bytes of
+ * records. Records are appended at head and the oldest ones are dropped at tail; both
+ * are byte positions that only grow, the offset into the record area is position modulo
+ * capacity. A record never wraps around the end of the area, the rest of the area is
+ * skipped instead. The writer moves tail before it overwrites a record and head after
+ * it has completed one, so the records between tail and head are always intact, even
+ * if the process dies while writing.
+ */
+struct FlightRecordHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint64_t capacity;
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> sequence;
+};
+
+struct FlightRecord {
+    uint32_t magic;
+    uint16_t type;
+    uint16_t sensor;
+    // payload bytes, the next record starts at the next multiple of 8
+    uint32_t size;
+    uint32_t reserved;
+    uint64_t sequence;
+    // microseconds
+    int64_t timestamp;
+};
+
+/**
+ * Payload of RECORD_SWEEP, followed by columns * layers distances in centimeters.
+ */
+struct SweepRecord {
+    double startAzimuth;
+    double endAzimuth;
+    uint32_t columns;
+    uint32_t layers;
+};
+
+/**
+ * Payload of RECORD_LABELS, followed by columns * layers labels, see LABEL_*.
+ */
+struct LabelRecord {
+    uint32_t columns;
+    uint32_t layers;
+};
+
+static const uint32_t FLIGHT_RECORD_MAGIC = 0x43455246; // "FREC"
+static const uint16_t FLIGHT_RECORD_VERSION = 1;
+static const uint32_t FLIGHT_RECORD_HEADER_SIZE = 4096;
+
+// record types
+static const uint16_t RECORD_PADDING = 0;
+// Pose
+static const uint16_t RECORD_POSE = 1;
+// SweepRecord and distances
+static const uint16_t RECORD_SWEEP = 2;
+// LabelRecord and labels
+static const uint16_t RECORD_LABELS = 3;
+// encoded ObstacleFrame
+static const uint16_t RECORD_TRACKS = 4;
+
+
+/**
+ * Always-on recorder of the recent past in a memory mapped ring file.
+ *
+ * The file is allocated and mapped once; recording a record is a copy into the mapping,
+ * the kernel writes the pages back in the background. Nothing is flushed or synced on
+ * the processing thread. A file that is left over from an earlier run is kept with the
+ * suffix ".1" for the post-mortem.
+ *
+ * Not thread-safe, records are written by the processing thread only.
+ */
+class FlightRecorder {
+private:
+    FlightRecorder(const FlightRecorder &/*obj*/);
+
+    FlightRecorder &operator=(const FlightRecorder &/*obj*/);
+
+public:
+    /**
+     * @param path File to record into.
+     * @param capacity Size of the record area in bytes.
+     */
+    FlightRecorder(const std::string &path, uint64_t capacity);
+
+    ~FlightRecorder();
+
+    bool isOpen() const;
+
+    void recordPose(const Pose &pose);
+
+    void recordSweep(const Sweep &sweep);
+
+    void recordLabels(int64_t timestamp, const uint16_t *labels, uint32_t columns, uint32_t layers);
+
+    /**
+     * @param frame Encoded ObstacleFrame.
+     */
+    void recordTracks(int64_t timestamp, const std::string &frame);
+
+    /**
+     * Bytes per second to record one lidar with labels and tracks at 10 Hz, to size the
+     * capacity for a number of seconds.
+     */
+    static uint64_t bytesPerSecond(uint32_t sensors);
+
+private:
+    /**
+     * Drops the oldest records until size payload bytes fit and writes the record
+     * header.
+     *
+     * @return Where the payload goes.
+     */
+    char *reserve(uint16_t type, uint16_t sensor, int64_t timestamp, uint32_t size);
+
+    /**
+     * Publishes the record of the last reserve().
+     */
+    void commit();
+
+    void dropOldest();
+
+    std::string m_path;
+    void *m_region;
+    size_t m_size;
+    FlightRecordHeader *m_header;
+    char *m_records;
+    uint64_t m_pending;
+};
+
+
+/**
+ * Reads the records of a flight record file, oldest first.
+ */
+class FlightRecordReader {
+private:
+    FlightRecordReader(const FlightRecordReader &/*obj*/);
+
+    FlightRecordReader &operator=(const FlightRecordReader &/*obj*/);
+
+public:
+    explicit FlightRecordReader(const std::string &path);
+
+    ~FlightRecordReader();
+
+    bool isOpen() const;
+
+    /**
+     * Moves to the next record, padding is skipped.
+     *
+     * @return False once all records have been read.
+     */
+    bool next();
+
+    const FlightRecord &record() const;
+
+    const char *payload() const;
+
+private:
+    void *m_region;
+    size_t m_size;
+    const FlightRecordHeader *m_header;
+    const char *m_records;
+    uint64_t m_position;
+    uint64_t m_end;
+    const FlightRecord *m_record;
+};
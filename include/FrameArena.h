@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Memory mapped in 2 MiB huge pages. Without reserved huge pages (vm.nr_hugepages) it
+ * falls back to ordinary pages with a transparent huge page hint. The memory is
+ * pre-faulted, so its first use neither faults nor zeroes pages.
+ */
+class HugePages {
+public:
+    static const size_t PAGE_SIZE = 2 * 1024 * 1024;
+
+    /**
+     * @param hugePages Set to true if reserved huge pages were mapped.
+     * @return Zeroed memory of bytes rounded up to PAGE_SIZE, nullptr if none is left.
+     */
+    static void *map(size_t bytes, bool *hugePages = nullptr);
+
+    static void unmap(void *memory, size_t bytes);
+};
+
+/**
+ * Bump allocator for the working storage of one frame, reset at the frame boundary.
+ *
+ * Allocations are never freed on their own, reset() releases all of them at once. Once
+ * the arena is full, allocations fall back to the heap until the next reset(), so the
+ * capacity only affects the speed. An arena is used by one thread at a time.
+ */
+class FrameArena {
+private:
+    FrameArena(const FrameArena &/*obj*/);
+
+    FrameArena &operator=(const FrameArena &/*obj*/);
+
+public:
+    explicit FrameArena(size_t capacity);
+
+    ~FrameArena();
+
+    void *allocate(size_t bytes, size_t alignment);
+
+    /**
+     * Releases all allocations since the last reset.
+     */
+    void reset();
+
+    size_t capacity() const;
+
+    /**
+     * @return Bytes handed out since the last reset, without the heap fallback.
+     */
+    size_t used() const;
+
+    /**
+     * @return Most bytes handed out between two resets.
+     */
+    size_t peak() const;
+
+    /**
+     * @return Allocations that went to the heap since the last reset.
+     */
+    uint32_t overflows() const;
+
+    /**
+     * @return True if the arena lies in reserved huge pages.
+     */
+    bool hugePages() const;
+
+private:
+    // heap allocation after the arena ran full, chained until reset()
+    struct Overflow {
+        Overflow *next;
+    };
+
+    char *m_memory;
+    size_t m_capacity;
+    size_t m_used;
+    size_t m_peak;
+    Overflow *m_overflow;
+    uint32_t m_overflows;
+    bool m_hugePages;
+};
+
+/**
+ * STL allocator on a FrameArena. A default constructed allocator uses the heap, so
+ * containers of this type also work without an arena.
+ */
+template<typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator() : m_arena(nullptr) {}
+
+    explicit ArenaAllocator(FrameArena *arena) : m_arena(arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.arena()) {}
+
+    T *allocate(size_t n) {
+        if (m_arena == nullptr) {
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *memory, size_t /*n*/) {
+        if (m_arena == nullptr) {
+            ::operator delete(memory);
+        }
+    }
+
+    FrameArena *arena() const {
+        return m_arena;
+    }
+
+private:
+    FrameArena *m_arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena() == b.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena() != b.arena();
+}
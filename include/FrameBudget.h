@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Per-frame time budget.
+ *
+ * Keeps a running estimate of what each processing step costs and tells, before a step
+ * is run, whether the remaining steps are expected to overrun the budget. The caller then
+ * picks a cheaper strategy for that step and records it as a degradation, which is
+ * published with the frame (see the FRAME_* flags in ObstacleFrame.h).
+ *
+ * The steps are timed with the wall clock, so the degradations depend on the machine
+ * and its load. With setVirtualCosts(), a virtual clock advances by a fixed cost per
+ * unit of work instead, which makes them depend on the input only.
+ */
+class FrameBudget {
+public:
+    enum Step {
+        DECODE = 0, CLUSTER, TRACK, STEPS
+    };
+
+    FrameBudget();
+
+    /**
+     * @param budget Time available per frame in microseconds, 0 disables degradation.
+     */
+    void setBudget(int64_t budget);
+
+    /**
+     * @param costs Microseconds per unit of work for each step, see endStep(); nullptr
+     * goes back to the wall clock.
+     */
+    void setVirtualCosts(const double *costs);
+
+    void begin();
+
+    void beginStep(Step step);
+
+    /**
+     * @param work Units of work done in the step, only used by the virtual clock.
+     */
+    void endStep(Step step, uint64_t work);
+
+    /**
+     * @return True if the expected cost of step and all later steps does not fit into what
+     * is left of the budget.
+     */
+    bool isAtRisk(Step step) const;
+
+    void degrade(uint16_t flag);
+
+    uint16_t degradations() const;
+
+    /**
+     * @return Microseconds since begin().
+     */
+    int64_t elapsed() const;
+
+private:
+    int64_t m_budget;
+    bool m_virtual;
+    double m_costs[STEPS];
+    // virtual microseconds since begin()
+    double m_virtualElapsed;
+    std::chrono::steady_clock::time_point m_frameStart;
+    std::chrono::steady_clock::time_point m_stepStart;
+    // exponentially weighted moving average of the step durations in microseconds
+    double m_expected[STEPS];
+    uint16_t m_degradations;
+};
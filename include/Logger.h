@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+enum class LogLevel : uint8_t {
+    Debug = 0, Info = 1, Warning = 2, Error = 3
+};
+
+static const uint64_t NO_TRACK = UINT64_MAX;
+
+/**
+ * Binary log record. The message has to be a string literal, only its address is stored.
+ * A NaN value is written as n/a.
+ */
+struct LogRecord {
+    static const uint32_t MAX_VALUES = 4;
+
+    int64_t timestamp;
+    uint64_t track;
+    const char *message;
+    double values[MAX_VALUES];
+    uint8_t count;
+    LogLevel level;
+};
+
+/**
+ * Single producer single consumer ring of log records, one per producing thread.
+ */
+class LogRing {
+public:
+    static const uint32_t CAPACITY = 4096;
+
+    LogRing();
+
+    /**
+     * @return False if the ring is full and the record was dropped.
+     */
+    bool push(const LogRecord &record);
+
+    bool pop(LogRecord &record);
+
+    uint64_t dropped() const;
+
+private:
+    LogRecord m_records[CAPACITY];
+    std::atomic<uint32_t> m_head;
+    std::atomic<uint32_t> m_tail;
+    std::atomic<uint64_t> m_dropped;
+};
+
+/**
+ * Asynchronous logger for the processing path.
+ *
+ * Writing a record copies it into the calling thread's ring buffer, it never locks or
+ * does I/O. A background thread drains all rings, formats the records and writes them
+ * to the sink. Records below the configured level are not written at all, records that
+ * belong to a track only if the track is selected by the track filter.
+ */
+class Logger {
+public:
+    static const uint32_t MAX_TRACK_FILTER = 16;
+
+    static Logger &instance();
+
+    ~Logger();
+
+    void setLevel(LogLevel level);
+
+    /**
+     * Selects the tracks whose records are written. Without a filter no track records are
+     * written.
+     */
+    void setTrackFilter(const std::vector<uint64_t> &tracks);
+
+    /**
+     * Redirects the output. Must not be called while other threads are logging.
+     */
+    void setSink(std::ostream &sink);
+
+    inline bool isEnabled(LogLevel level) const {
+        return static_cast<uint8_t>(level) >= m_level.load(std::memory_order_relaxed);
+    }
+
+    bool isTrackEnabled(uint64_t track) const;
+
+    void write(LogLevel level, uint64_t track, const char *message, const double *values, uint32_t count);
+
+    /**
+     * Blocks until every record written so far has reached the sink.
+     */
+    void flush();
+
+private:
+    Logger();
+
+    Logger(const Logger &);
+
+    Logger &operator=(const Logger &);
+
+    LogRing &ring();
+
+    void run();
+
+    uint32_t drain();
+
+    void format(const LogRecord &record);
+
+    std::atomic<uint8_t> m_level;
+    std::atomic<uint32_t> m_trackFilterSize;
+    std::atomic<uint64_t> m_trackFilter[MAX_TRACK_FILTER];
+
+    std::mutex m_ringsMutex;
+    std::vector<std::unique_ptr<LogRing>> m_rings;
+    std::mutex m_drainMutex;
+    std::ostream *m_sink;
+    int64_t m_epoch;
+    uint64_t m_reportedDrops;
+
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
+
+
+template<typename... Values>
+inline void logMessage(LogLevel level, const char *message, Values... values) {
+    Logger &logger = Logger::instance();
+    if (logger.isEnabled(level)) {
+        const double v[] = {0.0, static_cast<double>(values)...};
+        logger.write(level, NO_TRACK, message, v + 1, sizeof...(values));
+    }
+}
+
+template<typename... Values>
+inline void logTrack(LogLevel level, uint64_t track, const char *message, Values... values) {
+    Logger &logger = Logger::instance();
+    if (logger.isEnabled(level) && logger.isTrackEnabled(track)) {
+        const double v[] = {0.0, static_cast<double>(values)...};
+        logger.write(level, track, message, v + 1, sizeof...(values));
+    }
+}
@@ -1,7 +1,8 @@
 #pragma once
 
 #include <vector>
-#include <opendavinci/odcore/base/module/DataTriggeredConferenceClientModule.h>
+#include <array>
+#include <cstdint>
 #include "Point.h"
 #include "Kalman.h"
 #include <eigen3/Eigen/Dense>
@@ -9,9 +10,22 @@
 #include "Cluster.h"
 #include <list>
 
+/**
+ * Oriented box where the points of a track are expected in the current frame.
+ */
+struct TrackBox {
+    float x;
+    float y;
+    float cos;
+    float sin;
+    float halfLength;
+    float halfWidth;
+};
+
 class LidarObstacle {
 private:
-    odcore::data::TimeStamp m_latestTimestamp;
+    // microseconds
+    int64_t m_latestTimestamp;
     std::list<std::array<int,2>> m_width;
     std::list<std::array<int,2>> m_length;
 
@@ -67,10 +81,27 @@ private:
 
     void updateRectangle();
 
+    /**
+     * @return True if the candidates of a hibernating track still match its cached box.
+     */
+    bool isAtRest(double movement_x, double movement_y) const;
+
+    /**
+     * Moves a hibernating track with the ego motion only.
+     */
+    void moveAtRest(double movement_x, double movement_y);
+
 
 public:
 
     int32_t m_confidence = 1;
+    bool m_tentative = true;
+    // a hibernating track stands still and skips the box fit and the filter
+    bool m_hibernating = false;
+    uint32_t m_stationary_frames = 0;
+    // centroid where the track came to rest, in the frame of the last refresh
+    double m_rest_x = 0;
+    double m_rest_y = 0;
     uint64_t m_initial_id = 0;
     uint32_t image_counter = 0;
 
@@ -104,10 +135,48 @@ public:
 
     std::list<Cluster *> clusterCandidates;
 
+    // valid after predict() if m_has_box
+    TrackBox m_box;
+    bool m_has_box = false;
+
+    /**
+     * Predicts the filter to current_time and, for a confirmed track with a fitted
+     * rectangle, the box of its points in the current frame: the rectangle moved by the
+     * ego motion and enlarged by the position uncertainty of the filter.
+     */
+    void predict(double movement_x, double movement_y, int64_t current_time);
+
+    /**
+     * @return True if the point lies in the predicted box.
+     */
     bool isInRect(Point &point);
-    LidarObstacle(Cluster *cluster, odcore::data::TimeStamp current_time, uint64_t id);
-    void refresh(double movement_x, double movement_y, odcore::data::TimeStamp current_time, int img_count);
+    LidarObstacle(Cluster *cluster, int64_t current_time, uint64_t id);
+    /**
+     * @param refit If false, a stable track keeps its fitted box and only moves it with the
+     * cluster mean.
+     * @param hibernate If true, a track that stands still for several frames hibernates:
+     * as long as its points stay in its box it is only moved with the ego motion.
+     */
+    void refresh(double movement_x, double movement_y, int64_t current_time, int img_count, bool refit = true, bool hibernate = true);
+    /**
+     * Position in the current frame around which clusters are associated with the track.
+     */
+    void expectedPosition(double movement_x, double movement_y, double &x, double &y) const;
+    /**
+     * @return False if the track hibernates and the center of the cluster is outside of
+     * its cached box.
+     */
+    bool overlaps(Cluster &cluster, double movement_x, double movement_y) const;
     double getDistance(Cluster &cluster);
     bool confidenceIsZero();
-    double getDt(odcore::data::TimeStamp current_time);
+    /**
+     * @return True for a new track until its first association, which refresh() only
+     * uses to follow the centroid.
+     */
+    bool isTentative() const;
+    /**
+     * @return True if the track has a fitted box and is reported.
+     */
+    bool isConfirmed() const;
+    double getDt(int64_t current_time);
 };
\ No newline at end of file
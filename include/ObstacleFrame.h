@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/**
+ * Binary wire format for the tracked obstacles of one frame.
+ *
+ * A frame is a fixed-size header followed by a packed array of fixed-size records and,
+ * if the header has FRAME_FREE_SPACE set, a FreeSpaceSection. All fields are little
+ * endian and naturally aligned, so a received buffer can be read in place without
+ * parsing. The header carries the record count and stride, which makes a frame
+ * self-delimiting on a stream socket.
+ */
+
+static const uint32_t OBSTACLE_FRAME_MAGIC = 0x5453424f; // "OBST"
+static const uint16_t OBSTACLE_FRAME_VERSION = 1;
+
+// header flags: degradations applied to meet the frame deadline
+static const uint16_t FRAME_DECIMATED = 1u << 0;
+static const uint16_t FRAME_NARROW_WINDOW = 1u << 1;
+static const uint16_t FRAME_SKIPPED_REFIT = 1u << 2;
+// header flag: a FreeSpaceSection follows the records. Readers that predate it cannot
+// delimit such frames, so only enable it for updated consumers.
+static const uint16_t FRAME_FREE_SPACE = 1u << 8;
+
+static const uint32_t FREE_SPACE_BINS = 360;
+static const uint16_t FREE_SPACE_NO_RETURN = 0xffff;
+
+#pragma pack(push, 1)
+
+struct ObstacleFrameHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t count;
+    uint32_t recordSize;
+    // microseconds
+    int64_t timestamp;
+};
+
+struct ObstacleRecord {
+    uint64_t id;
+    float x;
+    float y;
+    float theta;
+    float speed;
+    float yawRate;
+    float width;
+    float length;
+    // 0 -unclassified ; 1 - Car ; 2 cycelist ; 3 - pedestrian
+    uint8_t type;
+    uint8_t reserved[3];
+};
+
+/**
+ * Polar free-space contour around the ego position, in the frame of the records.
+ */
+struct FreeSpaceSection {
+    // centimeters to the nearest non-ground return per degree of bearing, bin 0 starts
+    // at the y axis and the bins go clockwise like the heading; FREE_SPACE_NO_RETURN if
+    // there is none
+    uint16_t range[FREE_SPACE_BINS];
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(ObstacleFrameHeader) == 24, "ObstacleFrameHeader layout changed");
+static_assert(sizeof(ObstacleRecord) == 40, "ObstacleRecord layout changed");
+static_assert(sizeof(FreeSpaceSection) == 720, "FreeSpaceSection layout changed");
+
+
+class ObstacleFrameWriter {
+public:
+    ObstacleFrameWriter();
+
+    /**
+     * Starts a new frame, dropping the previous one but keeping its storage.
+     *
+     * @param timestamp Frame timestamp in microseconds.
+     * @param flags Frame flags.
+     */
+    void begin(int64_t timestamp, uint16_t flags = 0);
+
+    void add(const ObstacleRecord &record);
+
+    /**
+     * Appends the free space and sets FRAME_FREE_SPACE. Call it after the last add().
+     */
+    void addFreeSpace(const FreeSpaceSection &freeSpace);
+
+    /**
+     * @return The encoded frame. Valid until the next call to begin().
+     */
+    const std::string &data() const;
+
+    uint32_t size() const;
+
+private:
+    std::string m_buffer;
+};
+
+
+class ObstacleFrameReader {
+public:
+    /**
+     * Wraps an encoded frame without copying it. The buffer has to outlive the reader.
+     *
+     * @param data Start of the frame.
+     * @param size Number of bytes available at data.
+     */
+    ObstacleFrameReader(const char *data, size_t size);
+
+    /**
+     * @return True if the buffer holds a complete frame of a known version.
+     */
+    bool isValid() const;
+
+    /**
+     * @return Number of bytes the frame occupies, or 0 if the buffer is incomplete.
+     */
+    size_t frameSize() const;
+
+    const ObstacleFrameHeader &header() const;
+
+    uint32_t size() const;
+
+    const ObstacleRecord &operator[](uint32_t i) const;
+
+    /**
+     * @return The free space, nullptr if the frame has none.
+     */
+    const FreeSpaceSection *freeSpace() const;
+
+private:
+    const char *m_data;
+    size_t m_size;
+    bool m_valid;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Point.h"
+
+/**
+ * Log-odds occupancy grid around the vehicle.
+ *
+ * Cells are fixed in the world and stored in a ring buffer: cell (gx, gy) lives at
+ * (gx mod size, gy mod size). When the vehicle moves, only the rows and columns that
+ * enter the window are cleared, the rest of the grid keeps its evidence.
+ *
+ * A cell is updated at most once per frame and hits win over misses, otherwise the
+ * many rays grazing the edge of an object would clear it again. With several lidars,
+ * the hits of all of them go in before the free space of any.
+ */
+class OccupancyGrid {
+public:
+    // tenths of log-odds; the narrow free clamp lets new objects show up within a frame or two
+    static const int8_t LOG_ODDS_HIT = 9;
+    static const int8_t LOG_ODDS_MISS = -4;
+    static const int8_t LOG_ODDS_MIN = -20;
+    static const int8_t LOG_ODDS_MAX = 35;
+
+    /**
+     * @param size Cells per side, rounded up to a power of two.
+     * @param resolution Side length of a cell in meters.
+     */
+    OccupancyGrid(uint32_t size, float resolution);
+
+    /**
+     * Centers the window on the ego position in world coordinates and starts a new frame.
+     */
+    void moveTo(double x, double y);
+
+    /**
+     * Marks the cell of every obstacle point of a sweep as occupied. Call it for every
+     * sweep of the frame before integrateFreeSpace().
+     *
+     * @param points Points around the ego position, see moveTo().
+     */
+    void integrateHits(Point (&points)[2000][16], unsigned int cloudSize);
+
+    /**
+     * Clears the cells along every column of a sweep up to its closest obstacle, or up to
+     * its farthest ground return.
+     *
+     * @param originX Position of the lidar relative to the ego position.
+     * @param originY Position of the lidar relative to the ego position.
+     */
+    void integrateFreeSpace(Point (&points)[2000][16], unsigned int cloudSize, float originX, float originY);
+
+    /**
+     * @return Log-odds of the cell at the world position, 0 outside of the window.
+     */
+    int8_t logOdds(double x, double y) const;
+
+    /**
+     * @return Occupancy probability of the cell at the world position.
+     */
+    float probability(double x, double y) const;
+
+    /**
+     * Copies the window row by row, starting at the cell (minX(), minY()).
+     */
+    void copyTo(std::vector<int8_t> &cells) const;
+
+    uint32_t size() const;
+
+    float resolution() const;
+
+    /**
+     * @return World cell index of the first column of the window.
+     */
+    int64_t minX() const;
+
+    int64_t minY() const;
+
+    void clear();
+
+private:
+    void update(int64_t gx, int64_t gy, int8_t delta);
+
+    /**
+     * Applies delta to the first count cells of m_ray.
+     */
+    void updateRay(uint32_t count, int8_t delta);
+
+    void clearColumns(int64_t begin, int64_t end);
+
+    void clearRows(int64_t begin, int64_t end);
+
+    uint32_t m_size;
+    uint32_t m_mask;
+    float m_resolution;
+    // one cell more than the window, rays beyond the window update it
+    std::vector<int8_t> m_cells;
+    // frame of the last update per cell
+    std::vector<uint32_t> m_updated;
+    // cells along the current ray
+    std::vector<uint32_t> m_ray;
+    uint32_t m_frame;
+    int64_t m_minX;
+    int64_t m_minY;
+    // ego position in world coordinates
+    double m_x;
+    double m_y;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+enum class PerfEvent : uint8_t {
+    Cycles = 0, Instructions, L1Misses, LlcMisses, BranchMisses, DtlbMisses, COUNT
+};
+
+static const uint32_t PERF_EVENT_COUNT = static_cast<uint32_t>(PerfEvent::COUNT);
+
+/**
+ * @return Name of the event, a string literal.
+ */
+const char *perfEventName(PerfEvent event);
+
+/**
+ * Raw reading of a counter group, see PerfCounters::delta().
+ */
+struct PerfSample {
+    // nanoseconds the group was enabled and actually counting
+    uint64_t enabled;
+    uint64_t running;
+    uint64_t counts[PERF_EVENT_COUNT];
+    // false if the group could not be read
+    bool valid;
+};
+
+/**
+ * Hardware performance counters of the calling thread in user space, opened as one
+ * perf_event_open group so that all of them are read with a single system call.
+ *
+ * Events the CPU or the kernel does not offer are left out, e.g. the cache events in
+ * most virtual machines. Without perf events at all (perf_event_paranoid 3, seccomp, no
+ * PMU) the group is unavailable and reads return zeroes.
+ */
+class PerfCounters {
+private:
+    PerfCounters(const PerfCounters &/*obj*/);
+
+    PerfCounters &operator=(const PerfCounters &/*obj*/);
+
+public:
+    /**
+     * @return Group of the calling thread, opened on the first call on that thread.
+     */
+    static PerfCounters &thisThread();
+
+    PerfCounters();
+
+    ~PerfCounters();
+
+    bool available() const;
+
+    bool available(PerfEvent event) const;
+
+    /**
+     * Reads the unscaled counts since the group was opened, 0 for unavailable events.
+     */
+    void read(PerfSample &sample) const;
+
+    /**
+     * @param counts Receives PERF_EVENT_COUNT counts between the two samples, scaled up by
+     * the share of that interval in which the kernel multiplexed the counters out.
+     */
+    static void delta(const PerfSample &begin, const PerfSample &end, uint64_t *counts);
+
+private:
+    int32_t m_leader;
+    int32_t m_fds[PERF_EVENT_COUNT];
+    // position of every event in the read group, -1 if it is not open
+    int32_t m_slot[PERF_EVENT_COUNT];
+    uint32_t m_opened;
+};
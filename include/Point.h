@@ -9,6 +9,9 @@ private:
     float m_measurement;
     bool m_visited;
     bool m_isGround;
+    bool m_outsideRoi;
+    bool m_tracked;
+    bool m_static;
     Eigen::Vector3f m_point;
 
 
@@ -25,7 +28,38 @@ public:
 
     void setIsGround(bool isGround);
 
-    bool isGround();
+    bool isGround() const {
+        return m_isGround;
+    }
+
+    void setOutsideRoi(bool outside);
+
+    /**
+     * @return True if the point lies outside of the region of interest and is not clustered.
+     */
+    bool isOutsideRoi() const {
+        return m_outsideRoi;
+    }
+
+    void setTracked(bool tracked);
+
+    /**
+     * @return True if the point lies in the predicted box of a track and is assigned to
+     * it without clustering.
+     */
+    bool isTracked() const {
+        return m_tracked;
+    }
+
+    void setStatic(bool isStatic);
+
+    /**
+     * @return True if the point lies in a static cell of the StaticMap and is not
+     * clustered.
+     */
+    bool isStatic() const {
+        return m_static;
+    }
 
     void setX(float x);
 
@@ -39,7 +73,9 @@ public:
 
     const float getZ() const;
 
-    Eigen::Vector3f &getVec();
+    Eigen::Vector3f &getVec() {
+        return m_point;
+    }
 
     float getAzimuth();
 
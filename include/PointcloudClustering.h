@@ -1,20 +1,21 @@
 #pragma once
 
 #include <opendavinci/odcore/base/module/DataTriggeredConferenceClientModule.h>
-#include "opendavinci/generated/odcore/data/CompactPointCloud.h"
+#include <opendavinci/odcore/io/tcp/TCPConnection.h>
 #include "opendlv/data/scenario/Scenario.h"
-#include "opendlv/data/environment/WGS84Coordinate.h"
-#include <list>
-#include "Utils.h"
-#include "Point.h"
 #include <iostream>
-#include <random>
-#include <array>
-#include "dbscan.h"
-#include "Cluster.h"
-#include "Obstacle.h"
-#include <eigen3/Eigen/Dense>
-#include "Plane.h"
+#include <memory>
+#include "Utils.h"
+#include "PointcloudPipeline.h"
+#include "ContainerAdapter.h"
+#include "ScenarioMask.h"
+#include "ObstacleFrame.h"
+#include "SharedMemoryChannel.h"
+#include "FlightRecorder.h"
+#include "Logger.h"
+#include "StageTimer.h"
+#include "TaskScheduler.h"
+#include "RealtimeProfile.h"
 
 class PointcloudClustering : public odcore::base::module::DataTriggeredConferenceClientModule {
 private:
@@ -55,51 +56,43 @@ private:
 
     virtual void tearDown();
 
-    void transform(odcore::data::CompactPointCloud &cpc);
-
-    void segmentGroundByPlane();
-
-    void segmentGroundByHeight();
-
-    void trackObstacles(std::vector<Cluster> &clusters);
-
-    Point m_points[2000][16];
-    unsigned int m_cloudSize;
-    std::vector<Cluster> m_old_clusters;
-    std::list<LidarObstacle> m_obstacles;
-
-    double m_startAzimuth = 0;
-    double m_endAzimuth = 0;
-    int m_itCount = 100000;
-
-    double m_x, m_y, m_lon, m_lat, m_heading = 0;
-    double m_old_x = 0;
-    double m_old_y = 0;
-    double m_movement_x=0;
-    double m_movement_y=0;
-    bool m_imu_updateted = false;
-
-    std::list<Point *> getAllPointsNextToSlow(Eigen::Vector2d x, double delta);
+    /**
+     * Reads an optional value from the module's configuration.
+     *
+     * @param key Configuration key, e.g. "pointcloudclustering.shm.name".
+     * @param defaultValue Value to use if the key is not configured.
+     */
+    template<typename T>
+    T getConfigValue(const std::string &key, const T &defaultValue) {
+        try {
+            return getKeyValueConfiguration().getValue<T>(key);
+        }
+        catch (...) {
+            return defaultValue;
+        }
+    }
+
+    PointcloudPipeline m_pipeline;
+    ContainerAdapter m_adapter;
 
     opendlv::data::scenario::Scenario *m_scenario;
-    opendlv::data::environment::WGS84Coordinate *m_origin;
-
-
-    Plane m_bestGroundModel;
-    odcore::data::TimeStamp m_current_timestamp;
-
-
-    std::random_device rd;
-    std::mt19937 gen;
-
-//    opendlv::core::sensors::applanix::Grp1Data *m_imu;
-
 
-    Plane m_ground;
-    static constexpr float m_eps = 1000;
-    static constexpr uint32_t m_minPts = 20;
-    unsigned int m_id_counter = 0;
     std::shared_ptr<odcore::io::tcp::TCPConnection> connection;
+    ObstacleFrameWriter m_frameWriter;
+    std::vector<ObstacleRecord> m_records;
+    bool m_publishFreeSpace = false;
+    FreeSpaceSection m_freeSpace;
+    std::unique_ptr<SharedMemoryPublisher> m_shm;
+    bool m_shm_labels = false;
+    std::vector<uint16_t> m_labels;
+    std::shared_ptr<FlightRecorder> m_recorder;
+    std::shared_ptr<StaticMap> m_staticMap;
+    std::string m_staticPath;
+    bool m_staticLearn = false;
+    uint32_t m_statsInterval = 100;
+    uint32_t m_statsFrames = 0;
+    RealtimeProfile m_realtime;
+    bool m_realtimeApplied = false;
 
 
     uint32_t m_minutes = 0;
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
+#include "Point.h"
+#include "Cluster.h"
+#include "Obstacle.h"
+#include "PoseBuffer.h"
+#include "SensorFrontEnd.h"
+#include "OccupancyGrid.h"
+#include "StaticMap.h"
+#include "FrameBudget.h"
+#include "ObstacleFrame.h"
+#include "TrackIndex.h"
+#include "FlightRecorder.h"
+#include "SweepArchive.h"
+
+/**
+ * Lidar processing from the decoded sweep to the tracked obstacles.
+ *
+ * The pipeline only depends on plain types; converting the containers of a conference
+ * or a recording is left to the ContainerAdapter. Apart from the frame budget, it only
+ * uses the timestamps of the input, never the wall clock, so a recording can be
+ * replayed as fast as possible with the same results as live. The budget times the
+ * steps with the wall clock unless setBudgetCosts() gives it fixed costs.
+ *
+ * Several lidars can feed one pipeline. Sweeps of the secondary lidars are kept until
+ * the next sweep of the primary lidar arrives; then all of them are decoded, segmented
+ * and clustered in parallel and their clusters are tracked together in the frame of
+ * the primary lidar.
+ */
+class PointcloudPipeline {
+private:
+    PointcloudPipeline(const PointcloudPipeline &/*obj*/);
+
+    PointcloudPipeline &operator=(const PointcloudPipeline &/*obj*/);
+
+public:
+    PointcloudPipeline();
+
+    virtual ~PointcloudPipeline();
+
+    /**
+     * @param budget Time available per frame in microseconds, 0 disables degradation.
+     */
+    void setBudget(int64_t budget);
+
+    /**
+     * Runs the budget on a virtual clock instead of the wall clock, so that the
+     * degradations only depend on the input.
+     *
+     * @param costs Microseconds per unit of work for FrameBudget::DECODE (points),
+     * CLUSTER (points visited times the neighbourhood window) and TRACK (clusters plus
+     * tracks); nullptr goes back to the wall clock.
+     */
+    void setBudgetCosts(const double *costs);
+
+    void setGroundModel(GroundModel model);
+
+    /**
+     * Replaces the lidars, the first one is the primary lidar. By default there is a
+     * single lidar.
+     */
+    void setSensors(const std::vector<Extrinsics> &sensors);
+
+    uint32_t sensorCount() const;
+
+    /**
+     * Keeps an occupancy grid around the vehicle, see OccupancyGrid.
+     *
+     * @param size Cells per side, 0 disables the grid.
+     * @param resolution Side length of a cell in meters.
+     */
+    void setOccupancyGrid(uint32_t size, float resolution);
+
+    /**
+     * @return The occupancy grid, or nullptr if it is disabled.
+     */
+    const OccupancyGrid *occupancyGrid() const;
+
+    /**
+     * Only points inside the mask are clustered, nullptr clusters all points.
+     */
+    void setRoiMask(std::shared_ptr<const RoiMask> mask);
+
+    /**
+     * Points in static cells of the map are not clustered, nullptr clusters all points.
+     *
+     * @param learn Adds the structure seen in every frame to the map.
+     */
+    void setStaticMap(std::shared_ptr<StaticMap> map, bool learn);
+
+    /**
+     * Assigns the points in the predicted boxes of confirmed tracks to them before
+     * clustering, so only the remaining points go to DbScan. On by default.
+     */
+    void setGuidedSegmentation(bool guided);
+
+    /**
+     * Lets tracks that stand still skip the box fit and the filter until they move or
+     * change their shape. On by default.
+     */
+    void setHibernation(bool hibernation);
+
+    /**
+     * Records every pose and sweep that is fed in, nullptr stops recording.
+     */
+    void setRecorder(std::shared_ptr<FlightRecorder> recorder);
+
+    /**
+     * Archives every pose and sweep that is fed in, nullptr stops archiving.
+     */
+    void setArchive(std::shared_ptr<SweepArchiveWriter> archive);
+
+    /**
+     * Touches and reserves the frame, cluster and track buffers ahead of the first sweep.
+     * Call it after the setup, e.g. after mlockall(), so that the first frames neither
+     * fault nor allocate.
+     */
+    void prefault();
+
+    /**
+     * @param pose Ego pose in the local cartesian frame.
+     */
+    void addPose(const Pose &pose);
+
+    /**
+     * Runs ground segmentation, clustering and tracking once a sweep of the primary
+     * lidar arrives; sweeps of the other lidars are only stored.
+     *
+     * @return True if a frame has been processed.
+     */
+    bool process(const Sweep &sweep);
+
+    /**
+     * Writes one label per point of the last sweep of the primary lidar, see LABEL_* in
+     * SharedMemoryChannel.h.
+     */
+    void labelPoints(std::vector<uint16_t> &labels);
+
+    /**
+     * @return Points of the last sweep of the primary lidar.
+     */
+    Point (&points())[2000][16];
+
+    unsigned int cloudSize() const;
+
+    std::vector<Cluster> &clusters();
+
+    std::list<LidarObstacle> &obstacles();
+
+    /**
+     * Writes the tracks that are reported to consumers, see ObstacleFrame.h.
+     */
+    void confirmedTracks(std::vector<ObstacleRecord> &records) const;
+
+    /**
+     * Writes the polar free space of the last frame over all lidars, found in the ground
+     * segmentation.
+     */
+    void freeSpace(FreeSpaceSection &freeSpace) const;
+
+    /**
+     * @return Index over the positions of the tracks of confirmedTracks(), with their
+     * index in records as id.
+     */
+    const TrackIndex &confirmedIndex() const;
+
+    /**
+     * @return Timestamp of the last processed sweep in microseconds.
+     */
+    int64_t timestamp() const;
+
+    uint16_t degradations() const;
+
+    double movementX() const;
+
+    double movementY() const;
+
+    /**
+     * @return Ego position of the last frame in the local cartesian frame.
+     */
+    double egoX() const;
+
+    double egoY() const;
+
+    /**
+     * @return Index of the last processed sweep.
+     */
+    int frameIndex() const;
+
+private:
+    /**
+     * Runs task for every lidar in parallel on the TaskScheduler.
+     */
+    void forEachSensor(const std::function<void(uint32_t)> &task);
+
+    /**
+     * Runs task for every track in parallel on the TaskScheduler.
+     */
+    void forEachTrack(const std::function<void(LidarObstacle &)> &task);
+
+    /**
+     * Predicts all tracks into the current frame and collects the boxes that guide the
+     * segmentation.
+     */
+    void predictTracks();
+
+    void trackObstacles(std::vector<Cluster> &clusters);
+
+    std::vector<std::unique_ptr<SensorFrontEnd>> m_sensors;
+    std::vector<std::vector<Cluster>> m_sensor_clusters;
+    std::vector<Cluster> m_clusters;
+    // predicted boxes and their tracks
+    std::vector<TrackBox> m_boxes;
+    std::vector<LidarObstacle *> m_box_tracks;
+    std::vector<std::vector<Cluster>> m_sensor_guided;
+    // track of each of the first clusters, which were assigned by their boxes
+    std::vector<LidarObstacle *> m_guided_tracks;
+    bool m_guided = true;
+    bool m_hibernation = true;
+    std::list<LidarObstacle> m_obstacles;
+    // m_obstacles for indexed access
+    std::vector<LidarObstacle *> m_tracks;
+    // expected positions of m_tracks for the association
+    TrackIndex m_gate_index;
+    std::vector<double> m_expected_x;
+    std::vector<double> m_expected_y;
+    std::vector<uint32_t> m_gated;
+    TrackIndex m_confirmed_index;
+    std::unique_ptr<OccupancyGrid> m_grid;
+    std::shared_ptr<const RoiMask> m_roi;
+    std::shared_ptr<StaticMap> m_static;
+    bool m_learn_static = false;
+    std::shared_ptr<FlightRecorder> m_recorder;
+    std::shared_ptr<SweepArchiveWriter> m_archive;
+
+    int m_itCount = 100000;
+
+    double m_x = 0, m_y = 0, m_heading = 0;
+    double m_old_x = 0;
+    double m_old_y = 0;
+    double m_movement_x=0;
+    double m_movement_y=0;
+    bool m_imu_updateted = false;
+
+    PoseBuffer m_poses;
+    int64_t m_current_timestamp = 0;
+
+    GroundModel m_groundModel = GroundModel::Height;
+    FrameBudget m_budget;
+    unsigned int m_id_counter = 0;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+
+struct Pose {
+    // microseconds
+    int64_t timestamp;
+    double x;
+    double y;
+    // degrees
+    double heading;
+};
+
+/**
+ * Fixed capacity ring of ego poses ordered by time.
+ *
+ * Poses can be looked up at any timestamp; between two samples the pose is interpolated
+ * linearly, outside of the buffered range it is clamped to the oldest or newest sample.
+ */
+class PoseBuffer {
+public:
+    static const uint32_t CAPACITY = 512;
+
+    PoseBuffer();
+
+    /**
+     * Appends a pose. Poses older than the newest buffered one are dropped.
+     */
+    void push(const Pose &pose);
+
+    bool empty() const;
+
+    const Pose &newest() const;
+
+    Pose interpolate(int64_t timestamp) const;
+
+    /**
+     * Interpolates count poses at evenly spaced timestamps in a single pass, e.g. one per
+     * column of a sweep.
+     *
+     * @param begin Timestamp of the first pose.
+     * @param end Timestamp of the last pose.
+     * @param count Number of poses to write to out.
+     * @param out Destination for count poses.
+     */
+    void interpolate(int64_t begin, int64_t end, uint32_t count, Pose *out) const;
+
+private:
+    const Pose &at(uint32_t i) const;
+
+    uint32_t lowerBound(int64_t timestamp) const;
+
+    static Pose lerp(const Pose &a, const Pose &b, int64_t timestamp);
+
+    Pose m_poses[CAPACITY];
+    uint32_t m_head;
+    uint32_t m_size;
+};
+
+
+/**
+ * Cached conversion from WGS84 to the local cartesian frame.
+ *
+ * The exact geodetic transform is linearised around an anchor near the vehicle, so
+ * converting a pose is a 2x2 matrix product. The anchor has to be moved whenever the
+ * vehicle gets more than ANCHOR_RANGE degrees away from it.
+ */
+class LocalProjection {
+public:
+    static constexpr double ANCHOR_RANGE = 0.005;
+
+    LocalProjection();
+
+    bool needsAnchor(double lat, double lon) const;
+
+    /**
+     * @param lat Latitude of the anchor.
+     * @param lon Longitude of the anchor.
+     * @param x Cartesian x of the anchor.
+     * @param y Cartesian y of the anchor.
+     * @param dxdlat Change of x per degree latitude at the anchor, dxdlon etc. accordingly.
+     */
+    void setAnchor(double lat, double lon, double x, double y, double dxdlat, double dxdlon, double dydlat, double dydlon);
+
+    void project(double lat, double lon, double &x, double &y) const;
+
+private:
+    bool m_anchored;
+    double m_lat, m_lon, m_x, m_y;
+    double m_dxdlat, m_dxdlon, m_dydlat, m_dydlon;
+};
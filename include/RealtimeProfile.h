@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Execution profile of the processing threads: the cores they run on, their scheduling
+ * policy and whether the memory of the process is locked.
+ *
+ * Without the needed privileges (CAP_SYS_NICE, CAP_IPC_LOCK or the matching rlimits)
+ * a setting is reported on cerr and skipped, the others still apply.
+ */
+struct RealtimeProfile {
+    // Cores of the processing thread and the workers of the TaskScheduler: the first
+    // for the processing thread, the others in turn for the workers. Empty leaves the
+    // affinity alone.
+    std::vector<int> cores;
+    // SCHED_FIFO priority between 1 and 99, 0 keeps the default scheduler
+    int priority = 0;
+    // mlockall() the current and future memory of the process
+    bool lockMemory = false;
+
+    /**
+     * @param cores Comma separated, e.g. "2,3,4".
+     */
+    static std::vector<int> parseCores(const std::string &cores);
+
+    /**
+     * Locks the memory and sets up the workers of the TaskScheduler, which restarts them.
+     *
+     * @return False if a setting could not be applied.
+     */
+    bool applyToProcess() const;
+
+    /**
+     * Pins the calling thread to the first core and sets its priority.
+     *
+     * @return False if a setting could not be applied.
+     */
+    bool applyToThisThread() const;
+
+    /**
+     * @return Core of the given worker of the TaskScheduler, -1 for no affinity.
+     */
+    int coreOfWorker(uint32_t worker) const;
+
+    /**
+     * Touches the stack of the calling thread down to bytes below the current frame, so
+     * that later calls do not fault.
+     */
+    static void prefaultStack(size_t bytes);
+};
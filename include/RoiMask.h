@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Precomputed raster of the region of interest, e.g. the drivable area of a map, in the
+ * local cartesian frame. One bit per cell, so large maps stay small and a lookup is a
+ * shift and a mask.
+ */
+class RoiMask {
+public:
+    /**
+     * Creates an empty mask covering the given rectangle.
+     *
+     * @param resolution Side length of a cell in meters.
+     */
+    RoiMask(double minX, double minY, double maxX, double maxY, float resolution);
+
+    /**
+     * Adds a capsule: all cells within halfWidth of the segment from (x0, y0) to (x1, y1).
+     */
+    void addSegment(double x0, double y0, double x1, double y1, double halfWidth);
+
+    /**
+     * @return True if the position lies in the region, false outside of it or the mask.
+     */
+    bool contains(double x, double y) const {
+        const int64_t cx = static_cast<int64_t>((x - m_minX) * m_inverse);
+        const int64_t cy = static_cast<int64_t>((y - m_minY) * m_inverse);
+        if (x < m_minX || y < m_minY || cx >= m_width || cy >= m_height) {
+            return false;
+        }
+        const uint64_t bit = static_cast<uint64_t>(cy) * m_width + cx;
+        return (m_bits[bit >> 6] >> (bit & 63)) & 1;
+    }
+
+    uint32_t width() const;
+
+    uint32_t height() const;
+
+    /**
+     * @return Number of cells in the region.
+     */
+    uint64_t count() const;
+
+private:
+    void set(int64_t cx, int64_t cy);
+
+    double m_minX;
+    double m_minY;
+    float m_resolution;
+    double m_inverse;
+    int64_t m_width;
+    int64_t m_height;
+    std::vector<uint64_t> m_bits;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <memory>
+#include "opendlv/data/scenario/Scenario.h"
+#include "RoiMask.h"
+
+/**
+ * Rasterizes the lanes of a scenario into a region of interest mask.
+ *
+ * Lanes given as point models or straight lines become capsules of half the lane width
+ * plus margin around every segment; arcs and clothoids are not rasterized.
+ *
+ * @param resolution Side length of a cell in meters.
+ * @param margin Added on both sides of every lane in meters, e.g. for parked cars.
+ * @return The mask, or nullptr if the scenario has no supported lanes.
+ */
+std::shared_ptr<RoiMask> rasterizeScenario(const opendlv::data::scenario::Scenario &scenario, float resolution, double margin);
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <random>
+#include <vector>
+#include "Point.h"
+#include "Cluster.h"
+#include "Plane.h"
+#include "PoseBuffer.h"
+#include "RoiMask.h"
+#include "Obstacle.h"
+#include "StaticMap.h"
+#include "FrameArena.h"
+#include "ObstacleFrame.h"
+#include <eigen3/Eigen/Dense>
+
+/**
+ * One decoded revolution of a lidar: 16 distances in centimeters per column.
+ */
+struct Sweep {
+    // microseconds, time of the last column
+    int64_t timestamp;
+    // degrees
+    double startAzimuth;
+    double endAzimuth;
+    const uint16_t *distances;
+    uint32_t columns;
+    // index of the lidar, 0 is the primary one
+    uint32_t sensor;
+};
+
+/**
+ * Mounting of a lidar relative to the primary one, which defines the vehicle frame.
+ */
+struct Extrinsics {
+    // meters forward
+    double x = 0;
+    // meters to the left
+    double y = 0;
+    // meters up
+    double z = 0;
+    // degrees, clockwise like the heading
+    double yaw = 0;
+};
+
+enum class GroundModel {
+    // everything below a fixed height
+    Height,
+    // RANSAC plane through the lowest points of a few sectors
+    Plane
+};
+
+/**
+ * Per lidar part of the pipeline: decoding, ground segmentation and clustering.
+ *
+ * Front ends share nothing but the read-only pose buffer, so the front ends of several
+ * lidars can run concurrently.
+ *
+ * A front end lies in huge pages, like the FrameArena its clusters come from, to keep
+ * the strided neighbour search of DbScan within a few TLB entries.
+ */
+class SensorFrontEnd {
+private:
+    SensorFrontEnd(const SensorFrontEnd &/*obj*/);
+
+    SensorFrontEnd &operator=(const SensorFrontEnd &/*obj*/);
+
+public:
+    explicit SensorFrontEnd(const Extrinsics &extrinsics);
+
+    static void *operator new(size_t bytes);
+
+    static void operator delete(void *memory, size_t bytes);
+
+    void setGroundModel(GroundModel model);
+
+    /**
+     * Touches the point buffers and reserves the buffers that grow with the sweep, so
+     * that the first frames do not fault or allocate.
+     *
+     * @param boxes Number of predicted boxes to reserve for.
+     */
+    void prefault(uint32_t boxes);
+
+    /**
+     * Keeps a copy of a sweep until the next frame is fused.
+     */
+    void store(const Sweep &sweep);
+
+    /**
+     * @return True if a sweep has been stored since the last decode.
+     */
+    bool hasStored() const;
+
+    /**
+     * Converts a sweep into points around the reference pose. Every column is moved by
+     * the ego motion between its own time and the reference time.
+     *
+     * @param poses Ego poses of the vehicle.
+     * @param reference Ego pose at the time of the fused frame.
+     */
+    void decode(const Sweep &sweep, const PoseBuffer &poses, const Pose &reference);
+
+    /**
+     * Decodes the stored sweep, or empties the cloud if there is none.
+     */
+    void decodeStored(const PoseBuffer &poses, const Pose &reference);
+
+    void segmentGround();
+
+    /**
+     * Lowers the free space to the nearest non-ground return of every column of the last
+     * segmentGround(). Only the nearest return of a column is binned, by its own bearing.
+     */
+    void addFreeSpace(FreeSpaceSection &freeSpace) const;
+
+    /**
+     * Excludes the non-ground points outside of the region of interest from clustering.
+     *
+     * @param mask Region in the local cartesian frame.
+     * @return Number of excluded points.
+     */
+    uint32_t applyMask(const RoiMask &mask);
+
+    /**
+     * Excludes the non-ground points in static cells of the map from clustering.
+     *
+     * @return Number of excluded points.
+     */
+    uint32_t applyStaticMap(const StaticMap &map);
+
+    /**
+     * Notes the points above StaticMap::STRUCTURE_HEIGHT as structure in the map.
+     */
+    void observeStructure(StaticMap &map);
+
+    /**
+     * Assigns the non-ground points inside the predicted box of a track to that track,
+     * DbScan leaves them out then. A point in several boxes goes to the first one; boxes
+     * that catch fewer points than a DbScan cluster needs are ignored.
+     *
+     * Starts the clusters of a new frame: the clusters of this and the following
+     * cluster() are valid until the next call.
+     *
+     * @param clusters Receives one cluster per box, empty for ignored boxes.
+     * @return Number of assigned points.
+     */
+    uint32_t presegment(const std::vector<TrackBox> &boxes, std::vector<Cluster> &clusters);
+
+    /**
+     * @param stride Only every stride-th column is clustered.
+     * @param window Number of neighbouring columns searched on each side of a point.
+     */
+    void cluster(std::vector<Cluster> &clusters, int stride, int window);
+
+    Point (&points())[2000][16];
+
+    unsigned int cloudSize() const;
+
+    /**
+     * @return True if point belongs to the cloud of this front end.
+     */
+    bool owns(const Point *point) const;
+
+    /**
+     * @return Position of the lidar relative to the ego position of the last decode.
+     */
+    float originX() const;
+
+    float originY() const;
+
+private:
+    void segmentGroundByPlane();
+
+    void segmentGroundByHeight();
+
+    /**
+     * Finds the nearest non-ground return of a column, part of the ground segmentation.
+     */
+    void findNearestReturn(uint32_t column);
+
+    std::list<Point *> getAllPointsNextToSlow(Eigen::Vector2d x, double delta);
+
+    Extrinsics m_extrinsics;
+    float m_origin_x = 0;
+    float m_origin_y = 0;
+    // ego position of the last decode
+    double m_reference_x = 0;
+    double m_reference_y = 0;
+    GroundModel m_groundModel = GroundModel::Height;
+
+    Point m_points[2000][16];
+    unsigned int m_cloudSize = 0;
+    Pose m_column_poses[2000];
+    // squared horizontal range and ring of the nearest non-ground return per column,
+    // ring 16 if there is none
+    float m_nearest_range[2000];
+    uint8_t m_nearest_ring[2000];
+
+    double m_startAzimuth = 0;
+    double m_endAzimuth = 0;
+    int64_t m_last_timestamp = 0;
+    // microseconds
+    int64_t m_sweep_duration = 100000;
+
+    Sweep m_stored;
+    std::vector<uint16_t> m_stored_distances;
+    bool m_has_stored = false;
+
+    Plane m_bestGroundModel;
+
+    // predicted boxes as structure of arrays, see presegment()
+    std::vector<float> m_box_x;
+    std::vector<float> m_box_y;
+    std::vector<float> m_box_cos;
+    std::vector<float> m_box_sin;
+    std::vector<float> m_box_length;
+    std::vector<float> m_box_width;
+    std::vector<uint32_t> m_box_of;
+    std::vector<uint32_t> m_box_points;
+
+    FrameArena m_arena;
+
+    std::random_device rd;
+    std::mt19937 gen;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/**
+ * Layout of the POSIX shared memory region holding the latest published frame.
+ *
+ * The region starts with this header, followed by obstacleCapacity bytes for an encoded
+ * ObstacleFrame and labelCapacity per point labels (column major, layers per column).
+ * Access is guarded by a seqlock: the writer makes sequence odd while it updates the
+ * region and even again when it is done.
+ */
+struct SharedFrameHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    std::atomic<uint64_t> sequence;
+    uint32_t obstacleCapacity;
+    uint32_t labelCapacity;
+    uint32_t obstacleBytes;
+    uint32_t columns;
+    uint32_t layers;
+    uint32_t padding;
+};
+
+static const uint32_t SHARED_FRAME_MAGIC = 0x4d485350; // "PSHM"
+static const uint16_t SHARED_FRAME_VERSION = 1;
+
+// point labels
+static const uint16_t LABEL_NONE = 0;
+static const uint16_t LABEL_GROUND = 0xffff;
+static const uint16_t LABEL_OUTSIDE_ROI = 0xfffe;
+static const uint16_t LABEL_STATIC = 0xfffd;
+// cluster n is stored as n + LABEL_FIRST_CLUSTER
+static const uint16_t LABEL_FIRST_CLUSTER = 1;
+
+
+class SharedMemoryPublisher {
+public:
+    /**
+     * Creates the shared memory object and maps it. An object left by an earlier run is
+     * unlinked first rather than resized, so that readers still attached to it keep a
+     * valid mapping of their size.
+     *
+     * @param name Name of the POSIX shared memory object, e.g. "/pointcloud_clustering".
+     * @param obstacleCapacity Maximum size of an encoded obstacle frame in bytes.
+     * @param labelCapacity Maximum number of point labels, 0 to publish obstacles only.
+     */
+    SharedMemoryPublisher(const std::string &name, uint32_t obstacleCapacity, uint32_t labelCapacity);
+
+    ~SharedMemoryPublisher();
+
+    bool isOpen() const;
+
+    /**
+     * Publishes a frame. Frames or label sets larger than the region are truncated
+     * to nothing rather than partially written.
+     *
+     * @param frame Encoded ObstacleFrame.
+     * @param labels Point labels, may be nullptr.
+     * @param columns Number of columns in labels.
+     * @param layers Number of layers per column in labels.
+     */
+    void publish(const std::string &frame, const uint16_t *labels, uint32_t columns, uint32_t layers);
+
+private:
+    SharedMemoryPublisher(const SharedMemoryPublisher &);
+
+    SharedMemoryPublisher &operator=(const SharedMemoryPublisher &);
+
+    std::string m_name;
+    void *m_region;
+    size_t m_size;
+};
+
+
+class SharedMemoryReader {
+public:
+    explicit SharedMemoryReader(const std::string &name);
+
+    ~SharedMemoryReader();
+
+    /**
+     * @return False if the region could not be mapped or its publisher has closed it;
+     * a new reader then attaches to the region of the next publisher.
+     */
+    bool isOpen() const;
+
+    /**
+     * Hands the latest frame to visitor in place, without copying. The visitor may see
+     * a frame that is being overwritten; such reads are detected afterwards and false is
+     * returned, so anything the visitor extracted has to be discarded. Capacities in the
+     * header that do not fit into the mapping also return false, without calling the
+     * visitor.
+     *
+     * @param visitor Called as visitor(const SharedFrameHeader &, const char *obstacleFrame,
+     * const uint16_t *labels).
+     * @return True if the visitor saw a consistent frame.
+     */
+    template<typename Visitor>
+    bool read(Visitor visitor) const {
+        if (m_region == nullptr) {
+            return false;
+        }
+        const SharedFrameHeader *header = reinterpret_cast<const SharedFrameHeader *>(m_region);
+        uint64_t before = header->sequence.load(std::memory_order_acquire);
+        if (before & 1u || header->magic != SHARED_FRAME_MAGIC) {
+            return false;
+        }
+        const uint32_t obstacleCapacity = header->obstacleCapacity;
+        const uint32_t labelCapacity = header->labelCapacity;
+        if (!fits(obstacleCapacity, labelCapacity) || header->obstacleBytes > obstacleCapacity ||
+            static_cast<uint64_t>(header->columns) * header->layers > labelCapacity) {
+            return false;
+        }
+        const char *obstacles = reinterpret_cast<const char *>(header + 1);
+        const uint16_t *labels = labelCapacity > 0 ? reinterpret_cast<const uint16_t *>(obstacles + obstacleCapacity) : nullptr;
+        visitor(*header, obstacles, labels);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return header->sequence.load(std::memory_order_relaxed) == before;
+    }
+
+private:
+    SharedMemoryReader(const SharedMemoryReader &);
+
+    SharedMemoryReader &operator=(const SharedMemoryReader &);
+
+    /**
+     * @return True if a region with these capacities lies within the mapping.
+     */
+    bool fits(uint32_t obstacleCapacity, uint32_t labelCapacity) const {
+        return sizeof(SharedFrameHeader) + static_cast<uint64_t>(obstacleCapacity) + static_cast<uint64_t>(labelCapacity) * sizeof(uint16_t) <= m_size;
+    }
+
+    void *m_region;
+    size_t m_size;
+};
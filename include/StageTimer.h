@@ -0,0 +1,228 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "PerfCounters.h"
+
+enum class Stage : uint8_t {
+    Decode = 0, Ground, Presegment, Cluster, Associate, Filter, Shape, Grid, Serialize, Send, COUNT
+};
+
+static const uint32_t STAGE_COUNT = static_cast<uint32_t>(Stage::COUNT);
+
+/**
+ * @return Name of the stage, a string literal.
+ */
+const char *stageName(Stage stage);
+
+
+/**
+ * Lock-free latency histogram with logarithmic buckets in the style of HdrHistogram.
+ *
+ * Values below 32 are counted exactly, above that every power of two is split into 16
+ * linear sub buckets, which bounds the relative error of a reported percentile to 1/16.
+ */
+class LatencyHistogram {
+public:
+    static const uint32_t SUB_BUCKETS = 16;
+    static const uint32_t BUCKETS = 40 * SUB_BUCKETS;
+
+    LatencyHistogram();
+
+    void record(uint64_t value);
+
+    /**
+     * @param fraction Between 0 and 1, e.g. 0.99.
+     * @return Upper bound of the bucket holding the percentile, 0 without values.
+     */
+    uint64_t percentile(double fraction) const;
+
+    uint64_t max() const;
+
+    uint64_t count() const;
+
+    void reset();
+
+    static uint32_t bucketOf(uint64_t value);
+
+    static uint64_t upperBoundOf(uint32_t bucket);
+
+private:
+    std::atomic<uint64_t> m_counts[BUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_max;
+};
+
+
+/**
+ * Collects the time spent per stage in a frame and, at the end of the frame, feeds it
+ * into one histogram per stage plus one for the whole frame. Stages may run on several
+ * threads; their times are summed up.
+ *
+ * Binaries that link src/AllocationHook.cpp also count the heap allocations per stage,
+ * booked on the stage whose ScopedStageTimer is active on the allocating thread.
+ *
+ * With setCountingEvents(true), the timers also read the hardware performance counters
+ * of their thread, see PerfCounters, for the instructions per cycle and miss rates per
+ * stage.
+ */
+class StageTimers {
+public:
+    static StageTimers &instance();
+
+    void add(Stage stage, uint64_t nanoseconds);
+
+    /**
+     * Books an allocation, called by the allocation hook. Must not allocate.
+     *
+     * @param stage Stage::COUNT outside of all stages.
+     */
+    void addAllocation(Stage stage, uint64_t bytes);
+
+    void setCountingAllocations(bool counting);
+
+    /**
+     * @return True if the allocation hook is linked in.
+     */
+    bool countsAllocations() const;
+
+    /**
+     * Books hardware counter deltas, called by ScopedStageTimer.
+     */
+    void addEvents(Stage stage, const uint64_t *counts);
+
+    /**
+     * Reads the hardware performance counters around every stage. Costs two system calls
+     * per timer, so it is meant for profiling runs. Stays off if the counters cannot be
+     * opened.
+     *
+     * @return True if the counters are read.
+     */
+    bool setCountingEvents(bool counting);
+
+    bool countsEvents() const;
+
+    /**
+     * Drops the allocations since the last endFrame(), e.g. those of reading the input,
+     * so that the next frame only counts its own.
+     */
+    void beginFrame();
+
+    /**
+     * @param frameNanoseconds Wall clock time of the whole frame.
+     */
+    void endFrame(uint64_t frameNanoseconds);
+
+    const LatencyHistogram &histogram(Stage stage) const;
+
+    const LatencyHistogram &frameHistogram() const;
+
+    /**
+     * @param stage Stage::COUNT for the allocations outside of all stages.
+     * @return Histogram of the allocations per frame.
+     */
+    const LatencyHistogram &allocationHistogram(Stage stage) const;
+
+    const LatencyHistogram &frameAllocationHistogram() const;
+
+    /**
+     * @return Allocations of the last frame on all threads, inside and outside of stages.
+     */
+    uint64_t frameAllocations() const;
+
+    uint64_t frameAllocatedBytes() const;
+
+    /**
+     * @return True if the event was counted since the counters were last switched on,
+     * false if the CPU or the kernel does not offer it or they never were.
+     */
+    bool countsEvent(PerfEvent event) const;
+
+    /**
+     * @return Count of the event in the stage during the last frame, summed over threads.
+     * Also 0 if the event is not counted, see countsEvent().
+     */
+    uint64_t frameEvents(Stage stage, PerfEvent event) const;
+
+    /**
+     * @return Count of the event in the stage over all frames since the last report() or
+     * reset(). Also 0 if the event is not counted, see countsEvent().
+     */
+    uint64_t totalEvents(Stage stage, PerfEvent event) const;
+
+    /**
+     * @return Histogram of the instructions per cycle of the stage per frame, in
+     * thousandths.
+     */
+    const LatencyHistogram &ipcHistogram(Stage stage) const;
+
+    /**
+     * Writes p50/p99/max of every stage that ran to the logger, and the allocations per
+     * frame and the hardware counters if they are counted. Then calls reset(), so each
+     * report covers the frames since the previous one.
+     */
+    void report();
+
+    void reset();
+
+private:
+    StageTimers();
+
+    std::atomic<uint64_t> m_current[STAGE_COUNT];
+    std::atomic<bool> m_ran[STAGE_COUNT];
+    LatencyHistogram m_histograms[STAGE_COUNT];
+    LatencyHistogram m_frames;
+
+    // one more than there are stages for the allocations outside of all stages
+    std::atomic<uint64_t> m_allocations[STAGE_COUNT + 1];
+    std::atomic<uint64_t> m_allocatedBytes[STAGE_COUNT + 1];
+    LatencyHistogram m_allocationHistograms[STAGE_COUNT + 1];
+    LatencyHistogram m_frameAllocationHistogram;
+    uint64_t m_frameAllocations;
+    uint64_t m_frameAllocatedBytes;
+    std::atomic<bool> m_countingAllocations;
+
+    std::atomic<uint64_t> m_events[STAGE_COUNT][PERF_EVENT_COUNT];
+    uint64_t m_frameEvents[STAGE_COUNT][PERF_EVENT_COUNT];
+    uint64_t m_totalEvents[STAGE_COUNT][PERF_EVENT_COUNT];
+    LatencyHistogram m_ipcHistograms[STAGE_COUNT];
+    std::atomic<bool> m_countingEvents;
+    bool m_eventAvailable[PERF_EVENT_COUNT];
+};
+
+
+/**
+ * Measures the time until it goes out of scope and books it on a stage. Timers nest:
+ * while an inner timer runs, the enclosing one on the same thread is paused, so every
+ * nanosecond is booked on exactly one stage.
+ */
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(Stage stage);
+
+    ~ScopedStageTimer();
+
+    /**
+     * @return Stage of the innermost timer on the calling thread, Stage::COUNT for none.
+     */
+    static Stage activeStage();
+
+private:
+    ScopedStageTimer(const ScopedStageTimer &);
+
+    ScopedStageTimer &operator=(const ScopedStageTimer &);
+
+    void pause();
+
+    void resume();
+
+    Stage m_stage;
+    std::chrono::steady_clock::time_point m_start;
+    uint64_t m_elapsed;
+    ScopedStageTimer *m_parent;
+    // hardware counters at the last resume() and their sum while running
+    bool m_countingEvents;
+    PerfSample m_eventStart;
+    uint64_t m_events[PERF_EVENT_COUNT];
+};
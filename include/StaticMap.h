@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Layout of a static map file.
+ *
+ * The header is followed by tileCount StaticMapTile keys, padded to the next page, and
+ * the cells of the tiles in the same order, TILE_CELLS * TILE_CELLS bytes each. A tile
+ * is exactly one page, so the tiles of a mapped file can be used in place.
+ */
+struct StaticMapHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t tileCells;
+    float resolution;
+    uint32_t tileCount;
+};
+
+struct StaticMapTile {
+    int32_t x;
+    int32_t y;
+};
+
+static const uint32_t STATIC_MAP_MAGIC = 0x50414d53; // "SMAP"
+static const uint16_t STATIC_MAP_VERSION = 1;
+
+
+/**
+ * Persistent map of permanent structure, e.g. buildings and walls, in the local
+ * cartesian frame.
+ *
+ * Every cell counts the frames in which points above STRUCTURE_HEIGHT fell into it; a
+ * cell with STATIC_EVIDENCE frames is static and its points are not clustered any more.
+ * The map grows in tiles as the vehicle explores and is kept across drives: load() maps
+ * the file of the last drive copy-on-write, save() writes the extended map.
+ *
+ * Lookups go through a window of tile pointers around the vehicle that moveTo() updates
+ * once per frame, so a lookup is two array accesses. Lookups may run on several threads
+ * at once, the other methods must not.
+ */
+class StaticMap {
+private:
+    StaticMap(const StaticMap &/*obj*/);
+
+    StaticMap &operator=(const StaticMap &/*obj*/);
+
+public:
+    static const uint32_t TILE_CELLS = 64;
+    // tiles per side of the window around the vehicle
+    static const uint32_t WINDOW_TILES = 8;
+    static const uint8_t STATIC_EVIDENCE = 10;
+    // meters above the lidar, as for buildings in LidarObstacle::refresh()
+    static constexpr float STRUCTURE_HEIGHT = 4.5f;
+
+    /**
+     * @param resolution Side length of a cell in meters, replaced by the one of a loaded
+     * file.
+     */
+    explicit StaticMap(float resolution = 0.5f);
+
+    ~StaticMap();
+
+    /**
+     * Replaces the map with the one in the file.
+     *
+     * @return False if the file does not exist or is not a static map.
+     */
+    bool load(const std::string &path);
+
+    /**
+     * Writes the map to a temporary file that then replaces path.
+     */
+    bool save(const std::string &path) const;
+
+    /**
+     * Centers the window on the ego position in world coordinates.
+     */
+    void moveTo(double x, double y);
+
+    /**
+     * @return True if the cell at the world position is static, false outside of the
+     * window.
+     */
+    bool isStatic(double x, double y) const {
+        const int64_t cx = static_cast<int64_t>(std::floor(x * m_inverse)) - m_windowX;
+        const int64_t cy = static_cast<int64_t>(std::floor(y * m_inverse)) - m_windowY;
+        if (cx < 0 || cy < 0 || cx >= WINDOW_CELLS || cy >= WINDOW_CELLS) {
+            return false;
+        }
+        const uint8_t *tile = m_window[(cy / TILE_CELLS) * WINDOW_TILES + cx / TILE_CELLS];
+        return tile != nullptr && tile[(cy % TILE_CELLS) * TILE_CELLS + cx % TILE_CELLS] >= STATIC_EVIDENCE;
+    }
+
+    /**
+     * Notes structure at the world position; every cell counts once per frame.
+     */
+    void observe(double x, double y);
+
+    /**
+     * Adds the observations of the frame to the map.
+     */
+    void endFrame();
+
+    float resolution() const;
+
+    size_t tileCount() const;
+
+private:
+    static const int64_t WINDOW_CELLS = static_cast<int64_t>(WINDOW_TILES) * TILE_CELLS;
+
+    static int64_t key(int32_t x, int32_t y);
+
+    uint8_t *tile(int32_t x, int32_t y, bool create);
+
+    void updateWindow();
+
+    void unmap();
+
+    float m_resolution;
+    double m_inverse;
+
+    std::unordered_map<int64_t, uint8_t *> m_tiles;
+    // tiles created since the file was loaded
+    std::vector<std::unique_ptr<uint8_t[]>> m_owned;
+    void *m_region;
+    size_t m_size;
+
+    // first cell of the window
+    int64_t m_windowX;
+    int64_t m_windowY;
+    const uint8_t *m_window[WINDOW_TILES * WINDOW_TILES];
+
+    // cells observed in the current frame
+    std::vector<int64_t> m_observed;
+};
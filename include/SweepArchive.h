@@ -0,0 +1,213 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PoseBuffer.h"
+#include "SensorFrontEnd.h"
+
+/**
+ * File format of a sweep archive.
+ *
+ * The file starts with an ArchiveHeader, followed by one frame per sweep: an
+ * ArchiveFrame, the poses received since the previous sweep and the compressed
+ * distances, see RangeCodec. Closing the archive appends an index with one
+ * ArchiveIndexEntry per frame and an ArchiveTrailer. An archive without index, e.g.
+ * after a crash, is indexed by scanning the frames instead.
+ */
+#pragma pack(push, 1)
+
+struct ArchiveHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+};
+
+struct ArchiveFrame {
+    uint32_t magic;
+    uint16_t sensor;
+    uint16_t layers;
+    // microseconds
+    int64_t timestamp;
+    double startAzimuth;
+    double endAzimuth;
+    uint32_t columns;
+    uint32_t poseCount;
+    uint32_t payloadBytes;
+    uint32_t reserved;
+};
+
+struct ArchiveIndexEntry {
+    int64_t timestamp;
+    uint64_t offset;
+};
+
+struct ArchiveTrailer {
+    uint64_t indexOffset;
+    uint64_t count;
+    uint32_t magic;
+    uint32_t reserved;
+};
+
+#pragma pack(pop)
+
+static const uint32_t ARCHIVE_MAGIC = 0x41505753; // "SWPA"
+static const uint16_t ARCHIVE_VERSION = 1;
+static const uint32_t ARCHIVE_FRAME_MAGIC = 0x4d524653; // "SFRM"
+static const uint32_t ARCHIVE_INDEX_MAGIC = 0x58444953; // "SIDX"
+
+
+/**
+ * Lossless compression of range images.
+ *
+ * Every distance is predicted from its neighbours in the previous column and the
+ * previous ring with the median edge detector of LOCO-I, so the prediction follows
+ * both smooth surfaces and depth edges. The residuals are Rice coded with a parameter
+ * that adapts per ring to the recent residual magnitude.
+ */
+class RangeCodec {
+public:
+    /**
+     * Appends the compressed distances to out.
+     *
+     * @param distances columns * layers distances, column major.
+     */
+    static void encode(const uint16_t *distances, uint32_t columns, uint32_t layers, std::string &out);
+
+    /**
+     * @return False if the data is truncated.
+     */
+    static bool decode(const char *data, size_t size, uint32_t columns, uint32_t layers, uint16_t *distances);
+};
+
+
+/**
+ * Writes a sweep archive for long recordings.
+ *
+ * Sweeps are copied into a queue and compressed and written on a background thread,
+ * so the caller never waits for the disk. If the writer falls behind by more than
+ * QUEUE_CAPACITY sweeps, further sweeps are dropped and counted.
+ */
+class SweepArchiveWriter {
+private:
+    SweepArchiveWriter(const SweepArchiveWriter &/*obj*/);
+
+    SweepArchiveWriter &operator=(const SweepArchiveWriter &/*obj*/);
+
+public:
+    static const uint32_t QUEUE_CAPACITY = 32;
+
+    explicit SweepArchiveWriter(const std::string &path);
+
+    /**
+     * Closes the archive.
+     */
+    ~SweepArchiveWriter();
+
+    bool isOpen() const;
+
+    /**
+     * The pose is stored with the next sweep.
+     */
+    void addPose(const Pose &pose);
+
+    void addSweep(const Sweep &sweep);
+
+    /**
+     * Writes the queued sweeps and the index.
+     */
+    void close();
+
+    uint64_t dropped() const;
+
+private:
+    struct Entry {
+        Sweep sweep;
+        std::vector<Pose> poses;
+        std::vector<uint16_t> distances;
+    };
+
+    void run();
+
+    void writeFrame(const Entry &entry);
+
+    std::ofstream m_file;
+    std::vector<ArchiveIndexEntry> m_index;
+    uint64_t m_offset;
+    std::string m_payload;
+
+    std::vector<Pose> m_poses;
+    std::deque<Entry> m_queue;
+    // entries that are reused to keep their storage
+    std::vector<Entry> m_spare;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_closing;
+    uint64_t m_dropped;
+    std::thread m_thread;
+};
+
+
+/**
+ * Reads a sweep archive frame by frame.
+ */
+class SweepArchiveReader {
+private:
+    SweepArchiveReader(const SweepArchiveReader &/*obj*/);
+
+    SweepArchiveReader &operator=(const SweepArchiveReader &/*obj*/);
+
+public:
+    explicit SweepArchiveReader(const std::string &path);
+
+    bool isOpen() const;
+
+    uint64_t frameCount() const;
+
+    /**
+     * Continues with the first frame at or after timestamp.
+     *
+     * @return False if there is no such frame.
+     */
+    bool seek(int64_t timestamp);
+
+    /**
+     * Reads and decompresses the next frame.
+     *
+     * @return False at the end of the archive or if the frame is corrupt.
+     */
+    bool next();
+
+    /**
+     * @return Sweep of the current frame, valid until the next call to next().
+     */
+    const Sweep &sweep() const;
+
+    /**
+     * @return Poses received before the sweep of the current frame.
+     */
+    const std::vector<Pose> &poses() const;
+
+    /**
+     * @return True if the given file starts like a sweep archive.
+     */
+    static bool isArchive(const std::string &path);
+
+private:
+    bool readIndex();
+
+    void scanFrames();
+
+    std::ifstream m_file;
+    std::vector<ArchiveIndexEntry> m_index;
+    uint64_t m_frame;
+    Sweep m_sweep;
+    std::vector<Pose> m_poses;
+    std::vector<uint16_t> m_distances;
+    std::vector<char> m_payload;
+};
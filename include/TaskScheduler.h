@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing scheduler shared by all stages of the pipeline.
+ *
+ * Every worker has its own deque of tasks: it takes the newest task from the back,
+ * idle workers steal the oldest from the front of the others. A thread that is not a
+ * worker, e.g. the conference thread, submits into one of a few deques shared by such
+ * threads. While waiting for its tasks, the submitting thread runs tasks as well, so
+ * nested parallelFor() calls cannot deadlock and with 0 workers everything runs on the
+ * calling thread.
+ *
+ * Tasks must not throw.
+ */
+class TaskScheduler {
+private:
+    TaskScheduler(const TaskScheduler &/*obj*/);
+
+    TaskScheduler &operator=(const TaskScheduler &/*obj*/);
+
+public:
+    /**
+     * @return The scheduler, with one worker less than there are cores.
+     */
+    static TaskScheduler &instance();
+
+    ~TaskScheduler();
+
+    /**
+     * Replaces the workers. Must not be called while tasks run.
+     */
+    void setWorkerCount(uint32_t workers);
+
+    uint32_t workerCount() const;
+
+    /**
+     * Runs setup(worker) on every worker thread when it starts, e.g. to pin it to a core,
+     * and restarts the workers. Must not be called while tasks run.
+     */
+    void setWorkerSetup(const std::function<void(uint32_t)> &setup);
+
+    /**
+     * Runs task(begin, end) on chunks of at most grain indices that cover [0, count)
+     * and returns once all of them ran.
+     */
+    void parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)> &task);
+
+    /**
+     * @return Tasks that were taken from the deque of another thread.
+     */
+    uint64_t steals() const;
+
+private:
+    static const uint32_t EXTERNAL_QUEUES = 4;
+
+    struct Task {
+        const std::function<void(uint32_t, uint32_t)> *function;
+        uint32_t begin;
+        uint32_t end;
+        std::atomic<uint32_t> *pending;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    TaskScheduler();
+
+    void start(uint32_t workers);
+
+    void stop();
+
+    void run(uint32_t worker);
+
+    /**
+     * Runs one task, from the own queue first, stolen otherwise.
+     *
+     * @return False if there was no task.
+     */
+    bool runOne(uint32_t own);
+
+    /**
+     * @return Index of the queue of the calling thread.
+     */
+    uint32_t queueOfThisThread();
+
+    // one queue per worker, then EXTERNAL_QUEUES shared by all other threads
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::function<void(uint32_t)> m_setup;
+    // distinguishes the queue indices that threads cached before setWorkerCount()
+    std::atomic<uint32_t> m_generation;
+    std::atomic<uint32_t> m_externalThreads;
+
+    std::atomic<uint64_t> m_queued;
+    std::atomic<uint32_t> m_sleeping;
+    std::atomic<uint64_t> m_steals;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    bool m_stopping;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ObstacleFrame.h"
+
+/**
+ * Uniform grid over track positions around the ego position for radius, corridor and
+ * k-nearest queries.
+ *
+ * Positions beyond the grid are kept in its border cells, so queries stay exact
+ * anywhere and only get slower far out. The index is rebuilt every frame in linear
+ * time; its storage is kept, so a rebuild does not allocate once the track count is
+ * reached.
+ */
+class TrackIndex {
+public:
+    TrackIndex();
+
+    /**
+     * Drops all tracks. Queries need a build() after the next add().
+     */
+    void clear();
+
+    /**
+     * @param id Returned by the queries, e.g. the index of the track in a list.
+     */
+    void add(uint32_t id, float x, float y);
+
+    /**
+     * Sorts the added tracks into the grid.
+     */
+    void build();
+
+    /**
+     * Indexes the records of a received frame, with their index in the frame as id.
+     */
+    void build(const ObstacleFrameReader &frame);
+
+    uint32_t size() const;
+
+    /**
+     * @param ids Receives the tracks closer than radius to x, y in ascending order.
+     */
+    void radius(float x, float y, float radius, std::vector<uint32_t> &ids) const;
+
+    /**
+     * Tracks in a rectangle that starts at x, y and extends length meters along heading.
+     *
+     * @param heading Degrees, clockwise from the y axis like the ego heading.
+     * @param ids Receives the tracks in ascending order.
+     */
+    void corridor(float x, float y, float heading, float length, float halfWidth, std::vector<uint32_t> &ids) const;
+
+    /**
+     * @param ids Receives the k tracks closest to x, y, the closest first.
+     */
+    void nearest(float x, float y, uint32_t k, std::vector<uint32_t> &ids) const;
+
+private:
+    struct Entry {
+        uint32_t id;
+        float x;
+        float y;
+    };
+
+    int32_t column(float x) const;
+
+    int32_t row(float y) const;
+
+    /**
+     * Calls visit(entry) for every track in the cells between the given ones.
+     */
+    template<typename Visit>
+    void visitCells(int32_t firstColumn, int32_t lastColumn, int32_t firstRow, int32_t lastRow, Visit visit) const;
+
+    std::vector<Entry> m_added;
+    // m_added sorted by cell, the tracks of cell c start at m_start[c]
+    std::vector<Entry> m_entries;
+    std::vector<uint32_t> m_start;
+};
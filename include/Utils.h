@@ -8,10 +8,7 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
-#include "Cluster.h"
-
-#include <opencv2/core/core.hpp>
-#include <opencv2/highgui/highgui.hpp>
+#include <string>
 
 namespace utils {
 
@@ -52,6 +49,14 @@ namespace utils {
 
     int min(int a, int b);
 
+    /**
+    * Parses a comma separated list of unsigned numbers such as "54, 93". Malformed entries
+    * are skipped with a warning on stderr.
+    *
+    * @param name Config key of the list, named in the warning.
+    */
+    std::vector<uint64_t> parseIdList(const std::string &list, const std::string &name);
+
 
 }
 
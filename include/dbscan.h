@@ -11,20 +11,43 @@ public:
     void getClusters(std::vector<Cluster> &clusters);
 
     DbScan(Point (&points)[2000][16], unsigned int cloudSize)
-            : m_points(points), m_cloudSize(cloudSize) {
+            : m_points(points), m_cloudSize(cloudSize), m_window(5), m_stride(1), m_neighbors(), m_collection() {
     };
 
     void setDataReference(Point (&array)[2000][16], unsigned int cloudSize);
 
+    /**
+     * @param window Number of neighbouring columns searched on each side of a point.
+     */
+    void setWindow(int window);
+
+    /**
+     * Only clusters every stride-th column, the other columns are left unclustered.
+     */
+    void setColumnStride(int stride);
+
+    /**
+     * Takes the points of new clusters and the neighbour lists from arena instead of the
+     * heap. The clusters are valid until its next reset.
+     */
+    void setArena(FrameArena *arena);
+
 private:
 
 
-    void regionQuery(std::vector<Point *> &collection, Point *point);
+    void regionQuery(PointList &collection, Point *point);
+
+    void queryColumns(PointList &neighbors, Point *point, int begin, int end);
 
-    void expandCluster(std::vector<Point *> &neighbors, Cluster &cluster);
+    void expandCluster(PointList &neighbors, Cluster &cluster);
 
     Point (&m_points)[2000][16];
     unsigned int m_cloudSize;
+    int m_window;
+    int m_stride;
+    // reused for every point, so they only grow a few times per frame
+    PointList m_neighbors;
+    PointList m_collection;
     static constexpr float m_eps = 1.8;
     static constexpr uint32_t m_minPts = 5;
 };
@@ -0,0 +1,73 @@
+#include <cstdlib>
+#include <new>
+#include "StageTimer.h"
+
+/*
+ * Replaces the global operator new to count the heap allocations per stage, see
+ * StageTimers::addAllocation(). Linked into the benchmarks and the replay tool, and
+ * into the module with -DCOUNT_ALLOCATIONS=ON.
+ *
+ * The sized operator delete of the library forwards to these.
+ */
+
+static struct Install {
+    Install() {
+        StageTimers::instance().setCountingAllocations(true);
+    }
+} install;
+
+static void *allocate(std::size_t bytes) {
+    StageTimers::instance().addAllocation(ScopedStageTimer::activeStage(), bytes);
+    while (true) {
+        void *memory = std::malloc(bytes > 0 ? bytes : 1);
+        if (memory != nullptr) {
+            return memory;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+static void *allocateNothrow(std::size_t bytes) noexcept {
+    try {
+        return allocate(bytes);
+    } catch (std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+
+void *operator new(std::size_t bytes) {
+    return allocate(bytes);
+}
+
+void *operator new[](std::size_t bytes) {
+    return allocate(bytes);
+}
+
+void *operator new(std::size_t bytes, const std::nothrow_t &) noexcept {
+    return allocateNothrow(bytes);
+}
+
+void *operator new[](std::size_t bytes, const std::nothrow_t &) noexcept {
+    return allocateNothrow(bytes);
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
@@ -1,5 +1,6 @@
 #include "Cluster.h"
 #include <algorithm>
+#include <limits>
 #include <math.h>
 #include <vector>
 #include "Utils.h"
@@ -12,6 +13,13 @@ Cluster::Cluster() : m_cluster() {
     assigned = false;
 }
 
+Cluster::Cluster(const ArenaAllocator<Point *> &allocator) : m_cluster(allocator) {
+    m_center[0] = 0;
+    m_center[1] = 0;
+    m_center[2] = 0;
+    assigned = false;
+}
+
 void Cluster::mean() {
     m_center[0] = 0;
     m_center[1] = 0;
@@ -30,8 +38,8 @@ void Cluster::mean() {
 
 void Cluster::meanRect() {
 
-    m_center[0] = (m_rectangle[0].x + m_rectangle[1].x + m_rectangle[2].x + m_rectangle[3].x) / 4;
-    m_center[1] = (m_rectangle[0].y + m_rectangle[1].y + m_rectangle[2].y + m_rectangle[3].y) / 4;
+    m_center[0] = (m_rectangle[0][0] + m_rectangle[1][0] + m_rectangle[2][0] + m_rectangle[3][0]) / 4;
+    m_center[1] = (m_rectangle[0][1] + m_rectangle[1][1] + m_rectangle[2][1] + m_rectangle[3][1]) / 4;
     m_center[2] = 0;
 }
 
@@ -105,42 +113,68 @@ std::vector<Point *> Cluster::getHull() {
 }
 
 
+// Minimum area bounding rectangle: one of its sides is collinear with an edge of the
+// convex hull, so every hull edge direction is tried.
 void Cluster::calcRectangle() {
     auto hull = getHull();
-    std::vector<cv::Point2f> vec;
-    for (auto &point : hull) {
-        vec.push_back(cv::Point2f(point->getX(), point->getY()));
-    }
-    if (vec.size() > 2) {
-        auto rect = cv::minAreaRect(vec);
-        rect.points(m_rectangle);
+    if (hull.size() > 2) {
+        float best_area = std::numeric_limits<float>::max();
+        for (size_t i = 0; i < hull.size(); i++) {
+            const Point *a = hull[i];
+            const Point *b = hull[(i + 1) % hull.size()];
+            Eigen::Vector2f u(b->getX() - a->getX(), b->getY() - a->getY());
+            if (u.norm() == 0) {
+                continue;
+            }
+            u.normalize();
+            Eigen::Vector2f v(-u[1], u[0]);
+
+            float min_u = std::numeric_limits<float>::max(), max_u = -min_u;
+            float min_v = min_u, max_v = -min_u;
+            for (auto &point : hull) {
+                Eigen::Vector2f p(point->getX(), point->getY());
+                min_u = std::min(min_u, p.dot(u));
+                max_u = std::max(max_u, p.dot(u));
+                min_v = std::min(min_v, p.dot(v));
+                max_v = std::max(max_v, p.dot(v));
+            }
+
+            float area = (max_u - min_u) * (max_v - min_v);
+            if (area < best_area) {
+                best_area = area;
+                m_rectangle[0] = u * min_u + v * min_v;
+                m_rectangle[1] = u * max_u + v * min_v;
+                m_rectangle[2] = u * max_u + v * max_v;
+                m_rectangle[3] = u * min_u + v * max_v;
+            }
+        }
     }
 }
 
 double Cluster::getTheta() {
-    double lenA = cv::norm(m_rectangle[0] - m_rectangle[1]);
-    double lenB = cv::norm(m_rectangle[1] - m_rectangle[2]);
+    double lenA = (m_rectangle[0] - m_rectangle[1]).norm();
+    double lenB = (m_rectangle[1] - m_rectangle[2]).norm();
     // find long site
     if (lenA >= lenB)
         // make sure taking pint , i'm unsure that this is enough
-        if (m_rectangle[0].y < m_rectangle[1].y) {
-            return std::atan2(m_rectangle[1].y - m_rectangle[0].y, m_rectangle[1].x - m_rectangle[0].x);
+        if (m_rectangle[0][1] < m_rectangle[1][1]) {
+            return std::atan2(m_rectangle[1][1] - m_rectangle[0][1], m_rectangle[1][0] - m_rectangle[0][0]);
         } else {
-            return std::atan2(m_rectangle[0].y - m_rectangle[1].y, m_rectangle[0].x - m_rectangle[1].x);
+            return std::atan2(m_rectangle[0][1] - m_rectangle[1][1], m_rectangle[0][0] - m_rectangle[1][0]);
         }
     else {
-        if (m_rectangle[1].y < m_rectangle[2].y) {
-            return std::atan2(m_rectangle[2].y - m_rectangle[1].y, m_rectangle[2].x - m_rectangle[1].x);
+        if (m_rectangle[1][1] < m_rectangle[2][1]) {
+            return std::atan2(m_rectangle[2][1] - m_rectangle[1][1], m_rectangle[2][0] - m_rectangle[1][0]);
         } else {
-            return std::atan2(m_rectangle[1].y - m_rectangle[2].y, m_rectangle[1].x - m_rectangle[2].x);
+            return std::atan2(m_rectangle[1][1] - m_rectangle[2][1], m_rectangle[1][0] - m_rectangle[2][0]);
         }
     }
 }
 
 
 double Cluster::getRectShortSite() {
-    double lenA = cv::norm(m_rectangle[0] - m_rectangle[1]);
-    double lenB = cv::norm(m_rectangle[1] - m_rectangle[2]);
+    double lenA = (m_rectangle[0] - m_rectangle[1]).norm();
+    double lenB = (m_rectangle[1] - m_rectangle[2]).norm();
     if (lenA < lenB)
         return lenA;
     else
@@ -148,8 +182,8 @@ double Cluster::getRectShortSite() {
 }
 
 double Cluster::getRectLongSite() {
-    double lenA = cv::norm(m_rectangle[0] - m_rectangle[1]);
-    double lenB = cv::norm(m_rectangle[1] - m_rectangle[2]);
+    double lenA = (m_rectangle[0] - m_rectangle[1]).norm();
+    double lenB = (m_rectangle[1] - m_rectangle[2]).norm();
     if (lenA >= lenB)
         return lenA;
     else
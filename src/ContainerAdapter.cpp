@@ -0,0 +1,76 @@
+#include "ContainerAdapter.h"
+
+#include "opendavinci/generated/odcore/data/CompactPointCloud.h"
+#include "odvdapplanix/GeneratedHeaders_ODVDApplanix.h"
+#include "StageTimer.h"
+
+
+using namespace odcore::data;
+using namespace opendlv::data::environment;
+
+
+ContainerAdapter::ContainerAdapter() : m_origin(57.77284, 12.769964), m_projection(), m_senderStamps(), m_distances() {}
+
+void ContainerAdapter::setOrigin(double lat, double lon) {
+    m_origin = WGS84Coordinate(lat, lon);
+    m_projection = LocalProjection();
+}
+
+void ContainerAdapter::setSensors(const std::vector<uint32_t> &senderStamps) {
+    m_senderStamps = senderStamps;
+}
+
+void ContainerAdapter::anchorProjection(double lat, double lon) {
+    static const double step = 1e-4;
+    const Point3 anchor = m_origin.transform(WGS84Coordinate(lat, lon));
+    const Point3 north = m_origin.transform(WGS84Coordinate(lat + step, lon));
+    const Point3 east = m_origin.transform(WGS84Coordinate(lat, lon + step));
+    m_projection.setAnchor(lat, lon, anchor.getX(), anchor.getY(),
+                           (north.getX() - anchor.getX()) / step, (east.getX() - anchor.getX()) / step,
+                           (north.getY() - anchor.getY()) / step, (east.getY() - anchor.getY()) / step);
+}
+
+bool ContainerAdapter::feed(Container &c, PointcloudPipeline &pipeline) {
+    if (c.getDataType() == opendlv::core::sensors::applanix::Grp1Data::ID()) {
+        opendlv::core::sensors::applanix::Grp1Data imu = c.getData<opendlv::core::sensors::applanix::Grp1Data>();
+
+        Pose pose;
+        pose.timestamp = c.getSentTimeStamp().toMicroseconds();
+        pose.heading = imu.getHeading();
+        // the simulation sends cartesian positions and flags them with an impossible roll
+        if (imu.getRoll() > 1233) {
+            pose.x = imu.getLat();
+            pose.y = imu.getLon();
+        } else {
+            if (m_projection.needsAnchor(imu.getLat(), imu.getLon())) {
+                anchorProjection(imu.getLat(), imu.getLon());
+            }
+            m_projection.project(imu.getLat(), imu.getLon(), pose.x, pose.y);
+        }
+        pipeline.addPose(pose);
+    }
+
+    if (c.getDataType() == CompactPointCloud::ID()) {
+        Sweep sweep;
+        sweep.sensor = 0;
+        if (!m_senderStamps.empty()) {
+            auto stamp = std::find(m_senderStamps.begin(), m_senderStamps.end(), c.getSenderStamp());
+            if (stamp == m_senderStamps.end()) {
+                return false;
+            }
+            sweep.sensor = stamp - m_senderStamps.begin();
+        }
+        {
+            ScopedStageTimer timer(Stage::Decode);
+            CompactPointCloud cpc = c.getData<CompactPointCloud>();
+            m_distances = cpc.getDistances();
+            sweep.timestamp = c.getSentTimeStamp().toMicroseconds();
+            sweep.startAzimuth = cpc.getStartAzimuth();
+            sweep.endAzimuth = cpc.getEndAzimuth();
+            sweep.distances = reinterpret_cast<const uint16_t *>(m_distances.c_str());
+            sweep.columns = m_distances.size() / 2 / 16;
+        }
+        return pipeline.process(sweep);
+    }
+    return false;
+}
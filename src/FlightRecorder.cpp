@@ -0,0 +1,261 @@
+#include "FlightRecorder.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static uint64_t recordBytes(uint32_t size) {
+    return sizeof(FlightRecord) + ((static_cast<uint64_t>(size) + 7u) & ~7ull);
+}
+
+
+FlightRecorder::FlightRecorder(const std::string &path, uint64_t capacity) :
+        m_path(path), m_region(nullptr), m_size(0), m_header(nullptr), m_records(nullptr), m_pending(0) {
+    capacity = (capacity + 7u) & ~7ull;
+    m_size = FLIGHT_RECORD_HEADER_SIZE + capacity;
+
+    // keep the record of the previous run, it may be the one that is needed
+    struct stat info;
+    if (stat(m_path.c_str(), &info) == 0 && rename(m_path.c_str(), (m_path + ".1").c_str()) != 0) {
+        std::cerr << "Flight record " << m_path << " could not be kept: " << strerror(errno) << std::endl;
+    }
+
+    int fd = open(m_path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Flight record " << m_path << " could not be opened: " << strerror(errno) << std::endl;
+        return;
+    }
+    // allocate the blocks now, a full disk must not show up as SIGBUS while recording
+    int error = posix_fallocate(fd, 0, m_size);
+    if (error == EOPNOTSUPP || error == EINVAL) {
+        error = ftruncate(fd, m_size) == 0 ? 0 : errno;
+    }
+    if (error != 0) {
+        std::cerr << "Flight record " << m_path << " could not be allocated: " << strerror(error) << std::endl;
+        close(fd);
+        return;
+    }
+    void *region = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        std::cerr << "Flight record " << m_path << " could not be mapped: " << strerror(errno) << std::endl;
+        return;
+    }
+    m_region = region;
+    m_header = reinterpret_cast<FlightRecordHeader *>(m_region);
+    m_records = reinterpret_cast<char *>(m_region) + FLIGHT_RECORD_HEADER_SIZE;
+
+    m_header->version = FLIGHT_RECORD_VERSION;
+    m_header->reserved = 0;
+    m_header->capacity = capacity;
+    m_header->head.store(0, std::memory_order_relaxed);
+    m_header->tail.store(0, std::memory_order_relaxed);
+    m_header->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = FLIGHT_RECORD_MAGIC;
+}
+
+FlightRecorder::~FlightRecorder() {
+    if (m_region != nullptr) {
+        munmap(m_region, m_size);
+    }
+}
+
+bool FlightRecorder::isOpen() const {
+    return m_region != nullptr;
+}
+
+uint64_t FlightRecorder::bytesPerSecond(uint32_t sensors) {
+    const uint64_t sweep = recordBytes(sizeof(SweepRecord) + 2000 * 16 * sizeof(uint16_t));
+    const uint64_t labels = recordBytes(sizeof(LabelRecord) + 2000 * 16 * sizeof(uint16_t));
+    const uint64_t tracks = recordBytes(4096);
+    const uint64_t pose = recordBytes(sizeof(Pose));
+    return 10 * (sensors * sweep + labels + tracks) + 100 * pose;
+}
+
+void FlightRecorder::dropOldest() {
+    const uint64_t capacity = m_header->capacity;
+    uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+    const uint64_t offset = tail % capacity;
+    if (capacity - offset < sizeof(FlightRecord)) {
+        tail += capacity - offset;
+    } else {
+        tail += recordBytes(reinterpret_cast<const FlightRecord *>(m_records + offset)->size);
+    }
+    m_header->tail.store(tail, std::memory_order_release);
+}
+
+char *FlightRecorder::reserve(uint16_t type, uint16_t sensor, int64_t timestamp, uint32_t size) {
+    if (m_region == nullptr) {
+        return nullptr;
+    }
+    const uint64_t capacity = m_header->capacity;
+    const uint64_t total = recordBytes(size);
+    if (total > capacity) {
+        return nullptr;
+    }
+
+    uint64_t head = m_header->head.load(std::memory_order_relaxed);
+    const uint64_t remaining = capacity - head % capacity;
+    if (remaining < total) {
+        // skip to the start of the area
+        while (capacity - (head - m_header->tail.load(std::memory_order_relaxed)) < remaining) {
+            dropOldest();
+        }
+        if (remaining >= sizeof(FlightRecord)) {
+            FlightRecord *padding = reinterpret_cast<FlightRecord *>(m_records + head % capacity);
+            padding->magic = FLIGHT_RECORD_MAGIC;
+            padding->type = RECORD_PADDING;
+            padding->sensor = 0;
+            padding->size = remaining - sizeof(FlightRecord);
+            padding->reserved = 0;
+            padding->sequence = 0;
+            padding->timestamp = 0;
+        }
+        head += remaining;
+        m_header->head.store(head, std::memory_order_release);
+    }
+    while (capacity - (head - m_header->tail.load(std::memory_order_relaxed)) < total) {
+        dropOldest();
+    }
+
+    FlightRecord *record = reinterpret_cast<FlightRecord *>(m_records + head % capacity);
+    record->magic = FLIGHT_RECORD_MAGIC;
+    record->type = type;
+    record->sensor = sensor;
+    record->size = size;
+    record->reserved = 0;
+    record->sequence = m_header->sequence.fetch_add(1, std::memory_order_relaxed);
+    record->timestamp = timestamp;
+    m_pending = total;
+    return reinterpret_cast<char *>(record + 1);
+}
+
+void FlightRecorder::commit() {
+    m_header->head.store(m_header->head.load(std::memory_order_relaxed) + m_pending, std::memory_order_release);
+    m_pending = 0;
+}
+
+void FlightRecorder::recordPose(const Pose &pose) {
+    char *payload = reserve(RECORD_POSE, 0, pose.timestamp, sizeof(Pose));
+    if (payload != nullptr) {
+        memcpy(payload, &pose, sizeof(Pose));
+        commit();
+    }
+}
+
+void FlightRecorder::recordSweep(const Sweep &sweep) {
+    const uint32_t distances = sweep.columns * 16 * sizeof(uint16_t);
+    char *payload = reserve(RECORD_SWEEP, static_cast<uint16_t>(sweep.sensor), sweep.timestamp, sizeof(SweepRecord) + distances);
+    if (payload != nullptr) {
+        SweepRecord record;
+        record.startAzimuth = sweep.startAzimuth;
+        record.endAzimuth = sweep.endAzimuth;
+        record.columns = sweep.columns;
+        record.layers = 16;
+        memcpy(payload, &record, sizeof(record));
+        memcpy(payload + sizeof(record), sweep.distances, distances);
+        commit();
+    }
+}
+
+void FlightRecorder::recordLabels(int64_t timestamp, const uint16_t *labels, uint32_t columns, uint32_t layers) {
+    const uint32_t bytes = columns * layers * sizeof(uint16_t);
+    char *payload = reserve(RECORD_LABELS, 0, timestamp, sizeof(LabelRecord) + bytes);
+    if (payload != nullptr) {
+        LabelRecord record;
+        record.columns = columns;
+        record.layers = layers;
+        memcpy(payload, &record, sizeof(record));
+        memcpy(payload + sizeof(record), labels, bytes);
+        commit();
+    }
+}
+
+void FlightRecorder::recordTracks(int64_t timestamp, const std::string &frame) {
+    char *payload = reserve(RECORD_TRACKS, 0, timestamp, frame.size());
+    if (payload != nullptr) {
+        memcpy(payload, frame.data(), frame.size());
+        commit();
+    }
+}
+
+
+FlightRecordReader::FlightRecordReader(const std::string &path) :
+        m_region(nullptr), m_size(0), m_header(nullptr), m_records(nullptr), m_position(0), m_end(0), m_record(nullptr) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < FLIGHT_RECORD_HEADER_SIZE) {
+        close(fd);
+        return;
+    }
+    void *region = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        return;
+    }
+    const FlightRecordHeader *header = reinterpret_cast<const FlightRecordHeader *>(region);
+    if (header->magic != FLIGHT_RECORD_MAGIC || header->version != FLIGHT_RECORD_VERSION || header->capacity == 0 ||
+        FLIGHT_RECORD_HEADER_SIZE + header->capacity > static_cast<uint64_t>(info.st_size)) {
+        munmap(region, info.st_size);
+        return;
+    }
+    m_region = region;
+    m_size = info.st_size;
+    m_header = header;
+    m_records = reinterpret_cast<const char *>(region) + FLIGHT_RECORD_HEADER_SIZE;
+    m_end = header->head.load(std::memory_order_acquire);
+    m_position = header->tail.load(std::memory_order_acquire);
+}
+
+FlightRecordReader::~FlightRecordReader() {
+    if (m_region != nullptr) {
+        munmap(m_region, m_size);
+    }
+}
+
+bool FlightRecordReader::isOpen() const {
+    return m_region != nullptr;
+}
+
+bool FlightRecordReader::next() {
+    if (m_region == nullptr) {
+        return false;
+    }
+    const uint64_t capacity = m_header->capacity;
+    while (m_position < m_end) {
+        const uint64_t offset = m_position % capacity;
+        if (capacity - offset < sizeof(FlightRecord)) {
+            m_position += capacity - offset;
+            continue;
+        }
+        const FlightRecord *record = reinterpret_cast<const FlightRecord *>(m_records + offset);
+        if (record->magic != FLIGHT_RECORD_MAGIC || recordBytes(record->size) > capacity - offset) {
+            std::cerr << "Flight record is corrupt at " << m_position << std::endl;
+            m_position = m_end;
+            return false;
+        }
+        m_position += recordBytes(record->size);
+        if (record->type != RECORD_PADDING) {
+            m_record = record;
+            return true;
+        }
+    }
+    return false;
+}
+
+const FlightRecord &FlightRecordReader::record() const {
+    return *m_record;
+}
+
+const char *FlightRecordReader::payload() const {
+    return reinterpret_cast<const char *>(m_record + 1);
+}
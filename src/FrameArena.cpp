@@ -0,0 +1,113 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <new>
+#include <sys/mman.h>
+
+
+const size_t HugePages::PAGE_SIZE;
+
+static size_t roundUp(size_t bytes, size_t multiple) {
+    return (bytes + multiple - 1) / multiple * multiple;
+}
+
+
+void *HugePages::map(size_t bytes, bool *hugePages) {
+    bytes = roundUp(std::max<size_t>(bytes, 1), PAGE_SIZE);
+    if (hugePages != nullptr) {
+        *hugePages = false;
+    }
+
+    void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    if (memory != MAP_FAILED) {
+        if (hugePages != nullptr) {
+            *hugePages = true;
+        }
+        return memory;
+    }
+
+    // ordinary pages aligned to PAGE_SIZE, so that the kernel can back them with
+    // transparent huge pages
+    char *unaligned = static_cast<char *>(mmap(nullptr, bytes + PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (unaligned == MAP_FAILED) {
+        return nullptr;
+    }
+    char *aligned = reinterpret_cast<char *>(roundUp(reinterpret_cast<uintptr_t>(unaligned), PAGE_SIZE));
+    if (aligned > unaligned) {
+        munmap(unaligned, aligned - unaligned);
+    }
+    munmap(aligned + bytes, unaligned + PAGE_SIZE - aligned);
+    madvise(aligned, bytes, MADV_HUGEPAGE);
+    // volatile, so the compiler keeps the writes
+    volatile char *touch = aligned;
+    for (size_t i = 0; i < bytes; i += 4096) {
+        touch[i] = 0;
+    }
+    return aligned;
+}
+
+void HugePages::unmap(void *memory, size_t bytes) {
+    if (memory != nullptr) {
+        munmap(memory, roundUp(std::max<size_t>(bytes, 1), PAGE_SIZE));
+    }
+}
+
+
+FrameArena::FrameArena(size_t capacity) :
+        m_memory(nullptr), m_capacity(0), m_used(0), m_peak(0), m_overflow(nullptr), m_overflows(0), m_hugePages(false) {
+    m_memory = static_cast<char *>(HugePages::map(capacity, &m_hugePages));
+    if (m_memory != nullptr) {
+        m_capacity = capacity;
+    }
+}
+
+FrameArena::~FrameArena() {
+    reset();
+    HugePages::unmap(m_memory, m_capacity);
+}
+
+void *FrameArena::allocate(size_t bytes, size_t alignment) {
+    const size_t begin = roundUp(m_used, alignment);
+    if (begin + bytes <= m_capacity) {
+        m_used = begin + bytes;
+        m_peak = std::max(m_peak, m_used);
+        return m_memory + begin;
+    }
+
+    // the header keeps the alignment of every fundamental type
+    const size_t header = roundUp(sizeof(Overflow), alignof(std::max_align_t));
+    Overflow *overflow = static_cast<Overflow *>(::operator new(header + bytes));
+    overflow->next = m_overflow;
+    m_overflow = overflow;
+    m_overflows++;
+    return reinterpret_cast<char *>(overflow) + header;
+}
+
+void FrameArena::reset() {
+    while (m_overflow != nullptr) {
+        Overflow *next = m_overflow->next;
+        ::operator delete(m_overflow);
+        m_overflow = next;
+    }
+    m_used = 0;
+    m_overflows = 0;
+}
+
+size_t FrameArena::capacity() const {
+    return m_capacity;
+}
+
+size_t FrameArena::used() const {
+    return m_used;
+}
+
+size_t FrameArena::peak() const {
+    return m_peak;
+}
+
+uint32_t FrameArena::overflows() const {
+    return m_overflows;
+}
+
+bool FrameArena::hugePages() const {
+    return m_hugePages;
+}
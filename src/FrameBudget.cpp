@@ -0,0 +1,74 @@
+#include "FrameBudget.h"
+
+
+FrameBudget::FrameBudget() : m_budget(0), m_virtual(false), m_virtualElapsed(0), m_degradations(0) {
+    for (int i = 0; i < STEPS; i++) {
+        m_costs[i] = 0;
+        m_expected[i] = 0;
+    }
+}
+
+void FrameBudget::setBudget(int64_t budget) {
+    m_budget = budget;
+}
+
+void FrameBudget::setVirtualCosts(const double *costs) {
+    m_virtual = costs != nullptr;
+    for (int i = 0; i < STEPS; i++) {
+        m_costs[i] = m_virtual ? costs[i] : 0;
+        m_expected[i] = 0;
+    }
+}
+
+void FrameBudget::begin() {
+    m_frameStart = std::chrono::steady_clock::now();
+    m_virtualElapsed = 0;
+    m_degradations = 0;
+}
+
+void FrameBudget::beginStep(Step /*step*/) {
+    m_stepStart = std::chrono::steady_clock::now();
+}
+
+void FrameBudget::endStep(Step step, uint64_t work) {
+    static const double alpha = 0.2;
+    double duration;
+    if (m_virtual) {
+        duration = m_costs[step] * work;
+        m_virtualElapsed += duration;
+    } else {
+        duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_stepStart).count();
+    }
+    // adapt faster to spikes than to relief, so a dense sweep degrades the next one already
+    if (duration > m_expected[step]) {
+        m_expected[step] = 0.5 * m_expected[step] + 0.5 * duration;
+    } else {
+        m_expected[step] = (1 - alpha) * m_expected[step] + alpha * duration;
+    }
+}
+
+bool FrameBudget::isAtRisk(Step step) const {
+    if (m_budget <= 0) {
+        return false;
+    }
+    double expected = 0;
+    for (int i = step; i < STEPS; i++) {
+        expected += m_expected[i];
+    }
+    return elapsed() + expected > m_budget;
+}
+
+void FrameBudget::degrade(uint16_t flag) {
+    m_degradations |= flag;
+}
+
+uint16_t FrameBudget::degradations() const {
+    return m_degradations;
+}
+
+int64_t FrameBudget::elapsed() const {
+    if (m_virtual) {
+        return static_cast<int64_t>(m_virtualElapsed);
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_frameStart).count();
+}
@@ -0,0 +1,179 @@
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+
+
+const uint32_t LogRecord::MAX_VALUES;
+const uint32_t LogRing::CAPACITY;
+const uint32_t Logger::MAX_TRACK_FILTER;
+
+static int64_t nowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+LogRing::LogRing() : m_head(0), m_tail(0), m_dropped(0) {}
+
+bool LogRing::push(const LogRecord &record) {
+    uint32_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= CAPACITY) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_records[head % CAPACITY] = record;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogRing::pop(LogRecord &record) {
+    uint32_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    record = m_records[tail % CAPACITY];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+uint64_t LogRing::dropped() const {
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+
+Logger &Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() : m_level(static_cast<uint8_t>(LogLevel::Info)), m_trackFilterSize(0), m_rings(), m_sink(&std::cout),
+                   m_epoch(nowNanoseconds()), m_reportedDrops(0), m_running(true) {
+    for (uint32_t i = 0; i < MAX_TRACK_FILTER; i++) {
+        m_trackFilter[i] = NO_TRACK;
+    }
+    m_thread = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    drain();
+}
+
+void Logger::setLevel(LogLevel level) {
+    m_level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+void Logger::setTrackFilter(const std::vector<uint64_t> &tracks) {
+    uint32_t size = std::min<uint32_t>(tracks.size(), MAX_TRACK_FILTER);
+    m_trackFilterSize.store(0, std::memory_order_release);
+    for (uint32_t i = 0; i < size; i++) {
+        m_trackFilter[i].store(tracks[i], std::memory_order_relaxed);
+    }
+    m_trackFilterSize.store(size, std::memory_order_release);
+}
+
+void Logger::setSink(std::ostream &sink) {
+    std::lock_guard<std::mutex> lock(m_drainMutex);
+    m_sink = &sink;
+}
+
+bool Logger::isTrackEnabled(uint64_t track) const {
+    uint32_t size = m_trackFilterSize.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < size; i++) {
+        if (m_trackFilter[i].load(std::memory_order_relaxed) == track) {
+            return true;
+        }
+    }
+    return false;
+}
+
+LogRing &Logger::ring() {
+    static thread_local LogRing *ring = nullptr;
+    if (ring == nullptr) {
+        // once per thread; the logger owns the ring so it survives the thread
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        m_rings.push_back(std::unique_ptr<LogRing>(new LogRing()));
+        ring = m_rings.back().get();
+    }
+    return *ring;
+}
+
+void Logger::write(LogLevel level, uint64_t track, const char *message, const double *values, uint32_t count) {
+    LogRecord record;
+    record.timestamp = nowNanoseconds();
+    record.track = track;
+    record.message = message;
+    record.count = static_cast<uint8_t>(std::min(count, LogRecord::MAX_VALUES));
+    record.level = level;
+    for (uint32_t i = 0; i < record.count; i++) {
+        record.values[i] = values[i];
+    }
+    ring().push(record);
+}
+
+void Logger::flush() {
+    drain();
+}
+
+void Logger::run() {
+    while (m_running.load(std::memory_order_relaxed)) {
+        if (drain() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+}
+
+uint32_t Logger::drain() {
+    std::lock_guard<std::mutex> drainLock(m_drainMutex);
+    std::vector<LogRing *> rings;
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        for (auto &ring : m_rings) {
+            rings.push_back(ring.get());
+        }
+    }
+
+    uint32_t count = 0;
+    uint64_t dropped = 0;
+    LogRecord record;
+    for (auto ring : rings) {
+        while (ring->pop(record)) {
+            format(record);
+            count++;
+        }
+        dropped += ring->dropped();
+    }
+    if (dropped > m_reportedDrops) {
+        *m_sink << "[W] logger dropped " << (dropped - m_reportedDrops) << " records\n";
+        m_reportedDrops = dropped;
+    }
+    if (count > 0) {
+        m_sink->flush();
+    }
+    return count;
+}
+
+void Logger::format(const LogRecord &record) {
+    static const char levels[] = {'D', 'I', 'W', 'E'};
+    std::ostream &out = *m_sink;
+    out << '[' << levels[static_cast<uint8_t>(record.level)] << "] " << std::fixed << std::setprecision(6)
+        << (record.timestamp - m_epoch) / 1000000000.0 << ' ';
+    out.unsetf(std::ios_base::floatfield);
+    if (record.track != NO_TRACK) {
+        out << "track " << record.track << ' ';
+    }
+    out << record.message;
+    for (uint32_t i = 0; i < record.count; i++) {
+        if (std::isnan(record.values[i])) {
+            out << " n/a";
+        } else {
+            out << ' ' << record.values[i];
+        }
+    }
+    out << '\n';
+}
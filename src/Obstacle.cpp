@@ -2,9 +2,26 @@
 #include <math.h>
 #include <list>
 #include <iostream>
-#include <opencv2/imgcodecs.hpp>
-
-LidarObstacle::LidarObstacle(Cluster *cluster, odcore::data::TimeStamp current_time, uint64_t id) : clusterCandidates(), m_filter(), m_width(), m_length() {
+#include "Logger.h"
+#include "StageTimer.h"
+#include <algorithm>
+
+// the predicted box of a track is enlarged by this many standard deviations of its
+// position, within [BOX_MIN_MARGIN, BOX_MAX_MARGIN] meters
+static const float BOX_GATE_SIGMAS = 2.0f;
+static const float BOX_MIN_MARGIN = 0.3f;
+static const float BOX_MAX_MARGIN = 1.0f;
+
+// a confirmed track hibernates once its centroid stayed within HIBERNATE_SETTLE meters
+// for HIBERNATE_FRAMES frames, and wakes up once the centroid drifts HIBERNATE_DRIFT
+// meters from where it came to rest or more than HIBERNATE_OUTSIDE of its points leave
+// the cached box
+static const uint32_t HIBERNATE_FRAMES = 10;
+static const double HIBERNATE_SETTLE = 0.2;
+static const double HIBERNATE_DRIFT = 0.5;
+static const float HIBERNATE_OUTSIDE = 0.1f;
+
+LidarObstacle::LidarObstacle(Cluster *cluster, int64_t current_time, uint64_t id) : clusterCandidates(), m_filter(), m_width(), m_length() {
     m_latestTimestamp = current_time;
     m_state << cluster->m_center[0], cluster->m_center[1], 0;
     m_mean_x = cluster->m_center[0];
@@ -24,8 +41,78 @@ bool LidarObstacle::confidenceIsZero() {
     return m_confidence == 0;
 }
 
-double LidarObstacle::getDt(odcore::data::TimeStamp current_time) {
-    return (current_time - m_latestTimestamp).toMicroseconds() / 1000000.0d;
+bool LidarObstacle::isTentative() const {
+    return m_tentative;
+}
+
+bool LidarObstacle::isConfirmed() const {
+    return m_confidence >= 2 && m_best_length > 0;
+}
+
+void LidarObstacle::expectedPosition(double movement_x, double movement_y, double &x, double &y) const {
+    // the points are relative to the ego position, so the filter state of the last frame
+    // moves against the ego motion; hibernating tracks keep it on their box
+    x = m_filter.m_x[0] - movement_x;
+    y = m_filter.m_x[1] - movement_y;
+}
+
+bool LidarObstacle::overlaps(Cluster &cluster, double movement_x, double movement_y) const {
+    if (!m_hibernating) {
+        return true;
+    }
+    const float dx = cluster.m_center[0] - (m_rectangle_center[0] - movement_x);
+    const float dy = cluster.m_center[1] - (m_rectangle_center[1] - movement_y);
+    const float c = std::cos(m_rectRot);
+    const float s = std::sin(m_rectRot);
+    return std::fabs(dx * c + dy * s) <= m_best_length / 2 + HIBERNATE_DRIFT &&
+           std::fabs(-dx * s + dy * c) <= m_best_width / 2 + HIBERNATE_DRIFT;
+}
+
+void LidarObstacle::moveAtRest(double movement_x, double movement_y) {
+    // the points are relative to the ego position, so a standing object moves against
+    // the ego motion
+    const Eigen::Vector2f shift(-movement_x, -movement_y);
+    for (int i = 0; i < 4; i++) {
+        m_rectangle[i] += shift;
+    }
+    m_rectangle_center += shift;
+    m_movement_vector += shift;
+    m_movement_vector_filtered += shift;
+    m_rest_x -= movement_x;
+    m_rest_y -= movement_y;
+    m_filter.m_x[0] = m_rectangle_center[0];
+    m_filter.m_x[1] = m_rectangle_center[1];
+    m_rectRot_old = m_rectRot;
+}
+
+bool LidarObstacle::isAtRest(double movement_x, double movement_y) const {
+    const double rest_x = m_rest_x - movement_x;
+    const double rest_y = m_rest_y - movement_y;
+    if ((m_mean_x - rest_x) * (m_mean_x - rest_x) + (m_mean_y - rest_y) * (m_mean_y - rest_y) > HIBERNATE_DRIFT * HIBERNATE_DRIFT) {
+        return false;
+    }
+
+    const float center_x = m_rectangle_center[0] - movement_x;
+    const float center_y = m_rectangle_center[1] - movement_y;
+    const float c = std::cos(m_rectRot);
+    const float s = std::sin(m_rectRot);
+    const float halfLength = m_best_length / 2 + BOX_MIN_MARGIN;
+    const float halfWidth = m_best_width / 2 + BOX_MIN_MARGIN;
+    uint32_t outside = 0;
+    uint32_t total = 0;
+    for (auto &cluster : clusterCandidates) {
+        for (auto &point : cluster->m_cluster) {
+            const float dx = point->getX() - center_x;
+            const float dy = point->getY() - center_y;
+            outside += (std::fabs(dx * c + dy * s) > halfLength) | (std::fabs(-dx * s + dy * c) > halfWidth);
+        }
+        total += cluster->m_cluster.size();
+    }
+    return outside <= HIBERNATE_OUTSIDE * total;
+}
+
+double LidarObstacle::getDt(int64_t current_time) {
+    return (current_time - m_latestTimestamp) / 1000000.0;
 }
 
 
@@ -210,9 +297,7 @@ void LidarObstacle::updateRectangle() {
             point = rotCorrection.toRotationMatrix() * point;
         }
 
-        if (m_initial_id == 93) {
-            std::cout << "------ thetaCorrection: " << thetaCorrection << std::endl;
-        }
+        logTrack(LogLevel::Debug, m_initial_id, "thetaCorrection:", thetaCorrection);
 
 
         min_x = points.front()[0];
@@ -289,12 +374,14 @@ void LidarObstacle::updateRectangle() {
 
 }
 
-void LidarObstacle::refresh(double movement_x, double movement_y, odcore::data::TimeStamp current_time, int img_count) {
+void LidarObstacle::refresh(double movement_x, double movement_y, int64_t current_time, int img_count, bool refit, bool hibernate) {
     double dt = getDt(current_time);
     m_latestTimestamp = current_time;
 
     if (clusterCandidates.size() > 0) {
 
+        const double old_mean_x = m_mean_x;
+        const double old_mean_y = m_mean_y;
         m_mean_x = 0;
         m_mean_y = 0;
         double values_num = 0;
@@ -311,8 +398,8 @@ void LidarObstacle::refresh(double movement_x, double movement_y, odcore::data::
         m_mean_y /= values_num;
 
 
-        m_state[0] += movement_x;
-        m_state[1] += movement_y;
+        m_state[0] -= movement_x;
+        m_state[1] -= movement_y;
 
 
         float dx = m_mean_x - m_state[0];
@@ -332,17 +419,63 @@ void LidarObstacle::refresh(double movement_x, double movement_y, odcore::data::
         m_movement_vector[0] = std::cos(m_state[2]) * 5 + m_mean_x;
         m_movement_vector[1] = std::sin(m_state[2]) * 5 + m_mean_y;
 
+        if (isTentative()) {
+            // most new tracks die within a frame or two; the box, the size and the type
+            // are only estimated from the next association on, which also decides on the
+            // confidence
+            m_filter.init(m_mean_x, m_mean_y, m_state[2], 0, 0);
+            clusterCandidates.clear();
+            m_tentative = false;
+            return;
+        }
+
+        if (m_hibernating) {
+            if (isAtRest(movement_x, movement_y)) {
+                // the cached box, size and type stay valid
+                moveAtRest(movement_x, movement_y);
+                clusterCandidates.clear();
+                m_confidence++;
+                return;
+            }
+            m_hibernating = false;
+            m_stationary_frames = 0;
+            logTrack(LogLevel::Debug, m_initial_id, "wakes up");
+        }
+        // the centroid against the ego motion, independent of the filter
+        m_rest_x -= movement_x;
+        m_rest_y -= movement_y;
+        if (m_stationary_frames > 0 &&
+            (m_mean_x - m_rest_x) * (m_mean_x - m_rest_x) + (m_mean_y - m_rest_y) * (m_mean_y - m_rest_y) < HIBERNATE_SETTLE * HIBERNATE_SETTLE) {
+            m_stationary_frames++;
+        } else {
+            m_rest_x = m_mean_x;
+            m_rest_y = m_mean_y;
+            m_stationary_frames = 1;
+        }
+
 
         float oldPosX = m_rectangle_center[0];
         float oldPosY = m_rectangle_center[1];
 
-        updateRectangle();
+        if (refit || m_confidence < 3 || (oldPosX == 0 && oldPosY == 0)) {
+            ScopedStageTimer timer(Stage::Shape);
+            updateRectangle();
+        } else {
+            // keep the fitted box, only follow the cluster
+            Eigen::Vector2f shift(m_mean_x - old_mean_x, m_mean_y - old_mean_y);
+            for (int i = 0; i < 4; i++) {
+                m_rectangle[i] += shift;
+            }
+            m_rectangle_center += shift;
+            m_rectRot_old = m_rectRot;
+        }
 
 
         double speed = 0;
         if (oldPosX != 0 || oldPosY != 0) {
-            m_speed_x = 0.5 * ((m_rectangle_center[0] - movement_x - oldPosX) / dt) + m_speed_x * 0.5;
-            m_speed_y = 0.5 * ((m_rectangle_center[1] - movement_y - oldPosY) / dt) + m_speed_y * 0.5;
+            // the old center in the current frame is oldPos - movement
+            m_speed_x = 0.5 * ((m_rectangle_center[0] + movement_x - oldPosX) / dt) + m_speed_x * 0.5;
+            m_speed_y = 0.5 * ((m_rectangle_center[1] + movement_y - oldPosY) / dt) + m_speed_y * 0.5;
             speed = std::sqrt(m_speed_x * m_speed_x + m_speed_y * m_speed_y);
             if (speed > 100) {
                 speed = 0;
@@ -358,7 +491,10 @@ void LidarObstacle::refresh(double movement_x, double movement_y, odcore::data::
         }
         yaw_rate /= dt;
 
-        m_filter.update(m_rectangle_center[0], m_rectangle_center[1], m_rectRot, speed, yaw_rate, movement_x, movement_y);
+        {
+            ScopedStageTimer timer(Stage::Filter);
+            m_filter.update(m_rectangle_center[0], m_rectangle_center[1], m_rectRot, speed, yaw_rate, movement_x, movement_y);
+        }
 
 
         m_movement_vector_filtered[1] = std::sin(m_filter.m_x[2]) * m_filter.m_x[3];
@@ -392,30 +528,35 @@ void LidarObstacle::refresh(double movement_x, double movement_y, odcore::data::
         } else if (m_best_width > 4 || m_best_length > 7) {
             //std::cout << "Confidence Wrong size! "  << std::endl;
             m_confidence /= 2;
-        } else m_confidence++;
-
-
-        if (m_initial_id == 54) {
-            std::cout << "------------------------" << std::endl;
-            std::cout << "dt: " << dt << std::endl;
-            std::cout << "ID: " << m_initial_id << std::endl;
-//            std::cout << "Dx: " << dx << std::endl;
-//            std::cout << "Dy: " << dy << std::endl;
-//            std::cout << "movement_x: " << movement_x << std::endl;
-//            std::cout << "movement_y: " << movement_y << std::endl;
-            std::cout << "m_current_mean_x: " << m_rectangle_center[0] << std::endl;
-            std::cout << "m_current_mean_y: " << m_rectangle_center[1] << std::endl;
-            std::cout << "kalman_rot: " << m_filter.m_x[2] / M_PI * 180 << std::endl;
-            std::cout << "m_rectRot: " << m_rectRot / M_PI * 180 << std::endl;
-            std::cout << "Theta: " << m_state[2] / M_PI * 180 << std::endl;
-            std::cout << "speed: " << speed << std::endl;
-            std::cout << "m_best_width: " << m_best_width << std::endl;
-            std::cout << "m_best_length: " << m_best_length << std::endl;
-            std::cout << "yawrate: " << yaw_rate << std::endl;
+        } else {
+            m_confidence++;
+            if (hibernate && m_confidence >= 2 && m_stationary_frames >= HIBERNATE_FRAMES) {
+                m_hibernating = true;
+                m_filter.m_x[0] = m_rectangle_center[0];
+                m_filter.m_x[1] = m_rectangle_center[1];
+                m_filter.m_x[3] = 0;
+                m_filter.m_x[4] = 0;
+                logTrack(LogLevel::Debug, m_initial_id, "hibernates");
+            }
         }
 
+
+        logTrack(LogLevel::Debug, m_initial_id, "dt:", dt);
+        logTrack(LogLevel::Debug, m_initial_id, "m_current_mean:", m_rectangle_center[0], m_rectangle_center[1]);
+        logTrack(LogLevel::Debug, m_initial_id, "kalman_rot:", m_filter.m_x[2] / M_PI * 180);
+        logTrack(LogLevel::Debug, m_initial_id, "m_rectRot:", m_rectRot / M_PI * 180);
+        logTrack(LogLevel::Debug, m_initial_id, "Theta:", m_state[2] / M_PI * 180);
+        logTrack(LogLevel::Debug, m_initial_id, "speed:", speed);
+        logTrack(LogLevel::Debug, m_initial_id, "m_best_width:", m_best_width);
+        logTrack(LogLevel::Debug, m_initial_id, "m_best_length:", m_best_length);
+        logTrack(LogLevel::Debug, m_initial_id, "yawrate:", yaw_rate);
+
         m_confidence++;
     } else {
+        m_stationary_frames = 0;
+        if (m_hibernating) {
+            moveAtRest(movement_x, movement_y);
+        }
         m_confidence /= 2;
     }
 
@@ -429,13 +570,38 @@ double LidarObstacle::getDistance(Cluster &cluster) {
 }
 
 
+void LidarObstacle::predict(double movement_x, double movement_y, int64_t current_time) {
+    if (!m_hibernating) {
+        ScopedStageTimer timer(Stage::Filter);
+        m_filter.predict(getDt(current_time));
+    }
+
+    m_has_box = m_confidence >= 2 && m_best_length > 0 && m_best_width > 0 &&
+                (m_rectangle_center[0] != 0 || m_rectangle_center[1] != 0);
+    if (m_has_box) {
+        // position uncertainty of the filter, within sensible bounds
+        const float sigma = static_cast<float>(std::sqrt(std::max(m_filter.m_P(0, 0), m_filter.m_P(1, 1))));
+        const float margin = std::min(std::max(BOX_GATE_SIGMAS * sigma, BOX_MIN_MARGIN), BOX_MAX_MARGIN);
+        // The points are relative to the ego position, so the last fitted rectangle
+        // moves against the ego motion, like expectedPosition(); the margin covers the
+        // motion of the object during one sweep.
+        m_box.x = static_cast<float>(m_rectangle_center[0] - movement_x);
+        m_box.y = static_cast<float>(m_rectangle_center[1] - movement_y);
+        m_box.cos = static_cast<float>(std::cos(m_rectRot));
+        m_box.sin = static_cast<float>(std::sin(m_rectRot));
+        m_box.halfLength = m_best_length / 2 + margin;
+        m_box.halfWidth = m_best_width / 2 + margin;
+    }
+}
+
 bool LidarObstacle::isInRect(Point &point) {
-    Eigen::Rotation2D<float> rotCorrection(-m_rectRot);
-    Eigen::Vector2f rrect[4];
-    for (int i = 0; i < 4; i++) {
-        rrect[i] = rotCorrection.toRotationMatrix() * m_rectangle[i];
+    if (!m_has_box) {
+        return false;
     }
-    return true;
+    const float dx = point.getX() - m_box.x;
+    const float dy = point.getY() - m_box.y;
+    return std::fabs(dx * m_box.cos + dy * m_box.sin) <= m_box.halfLength &&
+           std::fabs(-dx * m_box.sin + dy * m_box.cos) <= m_box.halfWidth;
 }
 
 
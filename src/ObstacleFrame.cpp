@@ -0,0 +1,85 @@
+#include "ObstacleFrame.h"
+
+
+ObstacleFrameWriter::ObstacleFrameWriter() : m_buffer() {
+    m_buffer.reserve(sizeof(ObstacleFrameHeader) + 64 * sizeof(ObstacleRecord));
+    begin(0);
+}
+
+void ObstacleFrameWriter::begin(int64_t timestamp, uint16_t flags) {
+    ObstacleFrameHeader header;
+    header.magic = OBSTACLE_FRAME_MAGIC;
+    header.version = OBSTACLE_FRAME_VERSION;
+    header.flags = flags;
+    header.count = 0;
+    header.recordSize = sizeof(ObstacleRecord);
+    header.timestamp = timestamp;
+
+    m_buffer.assign(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void ObstacleFrameWriter::add(const ObstacleRecord &record) {
+    m_buffer.append(reinterpret_cast<const char *>(&record), sizeof(record));
+    ObstacleFrameHeader *header = reinterpret_cast<ObstacleFrameHeader *>(&m_buffer[0]);
+    header->count++;
+}
+
+void ObstacleFrameWriter::addFreeSpace(const FreeSpaceSection &freeSpace) {
+    m_buffer.append(reinterpret_cast<const char *>(&freeSpace), sizeof(freeSpace));
+    ObstacleFrameHeader *header = reinterpret_cast<ObstacleFrameHeader *>(&m_buffer[0]);
+    header->flags |= FRAME_FREE_SPACE;
+}
+
+const std::string &ObstacleFrameWriter::data() const {
+    return m_buffer;
+}
+
+uint32_t ObstacleFrameWriter::size() const {
+    return reinterpret_cast<const ObstacleFrameHeader *>(m_buffer.data())->count;
+}
+
+
+ObstacleFrameReader::ObstacleFrameReader(const char *data, size_t size) : m_data(data), m_size(size), m_valid(false) {
+    if (m_size < sizeof(ObstacleFrameHeader)) {
+        return;
+    }
+    const ObstacleFrameHeader &head = header();
+    // newer writers may append fields to a record, never remove them
+    m_valid = head.magic == OBSTACLE_FRAME_MAGIC && head.version == OBSTACLE_FRAME_VERSION &&
+              head.recordSize >= sizeof(ObstacleRecord) && frameSize() != 0;
+}
+
+bool ObstacleFrameReader::isValid() const {
+    return m_valid;
+}
+
+size_t ObstacleFrameReader::frameSize() const {
+    if (m_size < sizeof(ObstacleFrameHeader)) {
+        return 0;
+    }
+    const ObstacleFrameHeader &head = header();
+    size_t needed = sizeof(ObstacleFrameHeader) + static_cast<size_t>(head.count) * head.recordSize;
+    if (head.flags & FRAME_FREE_SPACE) {
+        needed += sizeof(FreeSpaceSection);
+    }
+    return needed <= m_size ? needed : 0;
+}
+
+const ObstacleFrameHeader &ObstacleFrameReader::header() const {
+    return *reinterpret_cast<const ObstacleFrameHeader *>(m_data);
+}
+
+uint32_t ObstacleFrameReader::size() const {
+    return m_valid ? header().count : 0;
+}
+
+const ObstacleRecord &ObstacleFrameReader::operator[](uint32_t i) const {
+    return *reinterpret_cast<const ObstacleRecord *>(m_data + sizeof(ObstacleFrameHeader) + static_cast<size_t>(i) * header().recordSize);
+}
+
+const FreeSpaceSection *ObstacleFrameReader::freeSpace() const {
+    if (!m_valid || !(header().flags & FRAME_FREE_SPACE)) {
+        return nullptr;
+    }
+    return reinterpret_cast<const FreeSpaceSection *>(m_data + sizeof(ObstacleFrameHeader) + static_cast<size_t>(header().count) * header().recordSize);
+}
@@ -0,0 +1,217 @@
+#include "OccupancyGrid.h"
+#include <algorithm>
+#include <cmath>
+
+
+const int8_t OccupancyGrid::LOG_ODDS_HIT;
+const int8_t OccupancyGrid::LOG_ODDS_MISS;
+const int8_t OccupancyGrid::LOG_ODDS_MIN;
+const int8_t OccupancyGrid::LOG_ODDS_MAX;
+
+// steps of a ray computed at once
+static const int32_t RAY_BLOCK = 16;
+
+
+OccupancyGrid::OccupancyGrid(uint32_t size, float resolution) :
+        m_size(1), m_mask(0), m_resolution(resolution), m_cells(), m_updated(), m_ray(), m_frame(0), m_minX(0), m_minY(0), m_x(0), m_y(0) {
+    while (m_size < size) {
+        m_size <<= 1;
+    }
+    m_mask = m_size - 1;
+    m_cells.assign(m_size * m_size + 1, 0);
+    m_updated.assign(m_size * m_size + 1, 0);
+    // the last block of a ray may run past its end
+    m_ray.resize(m_size / 2 + RAY_BLOCK);
+    m_minX = -static_cast<int64_t>(m_size / 2);
+    m_minY = -static_cast<int64_t>(m_size / 2);
+}
+
+void OccupancyGrid::update(int64_t gx, int64_t gy, int8_t delta) {
+    if (gx < m_minX || gy < m_minY || gx >= m_minX + m_size || gy >= m_minY + m_size) {
+        return;
+    }
+    const uint32_t index = (gy & m_mask) * m_size + (gx & m_mask);
+    if (m_updated[index] == m_frame) {
+        return;
+    }
+    m_updated[index] = m_frame;
+    int8_t &value = m_cells[index];
+    value = static_cast<int8_t>(std::max<int>(LOG_ODDS_MIN, std::min<int>(LOG_ODDS_MAX, value + delta)));
+}
+
+void OccupancyGrid::updateRay(uint32_t count, int8_t delta) {
+    // without branches, a ray crosses many cells it already updated
+    for (uint32_t s = 0; s < count; s++) {
+        const uint32_t index = m_ray[s];
+        const int8_t change = m_updated[index] != m_frame ? delta : 0;
+        m_updated[index] = m_frame;
+        int8_t &value = m_cells[index];
+        value = static_cast<int8_t>(std::max<int>(LOG_ODDS_MIN, std::min<int>(LOG_ODDS_MAX, value + change)));
+    }
+}
+
+void OccupancyGrid::clearColumns(int64_t begin, int64_t end) {
+    for (int64_t gx = begin; gx < end; gx++) {
+        for (uint32_t row = 0; row < m_size; row++) {
+            m_cells[row * m_size + (gx & m_mask)] = 0;
+        }
+    }
+}
+
+void OccupancyGrid::clearRows(int64_t begin, int64_t end) {
+    for (int64_t gy = begin; gy < end; gy++) {
+        std::fill_n(m_cells.begin() + (gy & m_mask) * m_size, m_size, 0);
+    }
+}
+
+void OccupancyGrid::moveTo(double x, double y) {
+    m_x = x;
+    m_y = y;
+    m_frame++;
+    const int64_t minX = static_cast<int64_t>(std::floor(x / m_resolution)) - m_size / 2;
+    const int64_t minY = static_cast<int64_t>(std::floor(y / m_resolution)) - m_size / 2;
+    const int64_t size = m_size;
+
+    if (std::abs(minX - m_minX) >= size || std::abs(minY - m_minY) >= size) {
+        clear();
+    } else {
+        // only the cells that scroll into the window are cleared
+        if (minX > m_minX) {
+            clearColumns(m_minX + size, minX + size);
+        } else if (minX < m_minX) {
+            clearColumns(minX, m_minX);
+        }
+        if (minY > m_minY) {
+            clearRows(m_minY + size, minY + size);
+        } else if (minY < m_minY) {
+            clearRows(minY, m_minY);
+        }
+    }
+    m_minX = minX;
+    m_minY = minY;
+}
+
+void OccupancyGrid::integrateHits(Point (&points)[2000][16], unsigned int cloudSize) {
+    const float inverse = 1.0f / m_resolution;
+    // positions in cells relative to the world origin
+    const float egoX = static_cast<float>(m_x * inverse);
+    const float egoY = static_cast<float>(m_y * inverse);
+    for (uint32_t i = 0; i < cloudSize; i++) {
+        for (uint32_t j = 0; j < 16; j++) {
+            Point &point = points[i][j];
+            if (!point.isGround() && point.getMeasurement() > 2.5) {
+                update(static_cast<int64_t>(std::floor(egoX + point.getX() * inverse)),
+                       static_cast<int64_t>(std::floor(egoY + point.getY() * inverse)), LOG_ODDS_HIT);
+            }
+        }
+    }
+}
+
+void OccupancyGrid::integrateFreeSpace(Point (&points)[2000][16], unsigned int cloudSize, float originX, float originY) {
+    const float inverse = 1.0f / m_resolution;
+    // lidar position in cells relative to the window
+    const float sensorX = static_cast<float>((m_x + originX) * inverse - m_minX);
+    const float sensorY = static_cast<float>((m_y + originY) * inverse - m_minY);
+    const float size = static_cast<float>(m_size);
+    const float maxRange = m_size / 2.0f;
+    // storage offset of the first column and row of the window
+    const uint32_t offsetX = static_cast<uint32_t>(m_minX & m_mask);
+    const uint32_t offsetY = static_cast<uint32_t>(m_minY & m_mask);
+    const uint32_t outside = m_size * m_size;
+    // locals, the stores into the ray could alias the members
+    const uint32_t mask = m_mask;
+    const uint32_t stride = m_size;
+
+    for (uint32_t i = 0; i < cloudSize; i++) {
+        float hitRange = maxRange;
+        float groundRange = 0;
+        float dirX = 0, dirY = 0;
+        bool hit = false;
+        for (uint32_t j = 0; j < 16; j++) {
+            Point &point = points[i][j];
+            if (point.getMeasurement() <= 2.5) {
+                continue;
+            }
+            const float dx = point.getX() * inverse - originX * inverse;
+            const float dy = point.getY() * inverse - originY * inverse;
+            const float range = std::sqrt(dx * dx + dy * dy);
+            if (range <= 0) {
+                continue;
+            }
+            if (point.isGround()) {
+                groundRange = std::max(groundRange, range);
+            } else {
+                hit = true;
+                hitRange = std::min(hitRange, range);
+            }
+            dirX = dx / range;
+            dirY = dy / range;
+        }
+
+        // free space along the column, one cell per step; the cells of all steps are
+        // computed first without branches in blocks of RAY_BLOCK steps, a fixed trip count
+        // that the compiler vectorizes at -O2
+        const float freeRange = std::min(hit ? hitRange - 1.0f : groundRange, maxRange);
+        const int32_t steps = static_cast<int32_t>(freeRange);
+        for (int32_t block = 0; block < steps; block += RAY_BLOCK) {
+            uint32_t *ray = m_ray.data() + block;
+            for (int32_t k = 0; k < RAY_BLOCK; k++) {
+                const float s = static_cast<float>(block + k);
+                const float x = sensorX + dirX * s;
+                const float y = sensorY + dirY * s;
+                const bool inside = (x >= 0) & (x < size) & (y >= 0) & (y < size);
+                // truncation is floor inside of the window
+                const uint32_t column = (static_cast<uint32_t>(static_cast<int32_t>(x)) + offsetX) & mask;
+                const uint32_t row = (static_cast<uint32_t>(static_cast<int32_t>(y)) + offsetY) & mask;
+                ray[k] = inside ? row * stride + column : outside;
+            }
+        }
+        if (steps > 0) {
+            updateRay(static_cast<uint32_t>(steps), LOG_ODDS_MISS);
+        }
+    }
+}
+
+int8_t OccupancyGrid::logOdds(double x, double y) const {
+    const int64_t gx = static_cast<int64_t>(std::floor(x / m_resolution));
+    const int64_t gy = static_cast<int64_t>(std::floor(y / m_resolution));
+    if (gx < m_minX || gy < m_minY || gx >= m_minX + m_size || gy >= m_minY + m_size) {
+        return 0;
+    }
+    return m_cells[(gy & m_mask) * m_size + (gx & m_mask)];
+}
+
+float OccupancyGrid::probability(double x, double y) const {
+    return 1.0f / (1.0f + std::exp(-logOdds(x, y) / 10.0f));
+}
+
+void OccupancyGrid::copyTo(std::vector<int8_t> &cells) const {
+    cells.resize(m_size * m_size);
+    for (uint32_t row = 0; row < m_size; row++) {
+        const int64_t gy = m_minY + row;
+        for (uint32_t column = 0; column < m_size; column++) {
+            const int64_t gx = m_minX + column;
+            cells[row * m_size + column] = m_cells[(gy & m_mask) * m_size + (gx & m_mask)];
+        }
+    }
+}
+
+uint32_t OccupancyGrid::size() const {
+    return m_size;
+}
+
+float OccupancyGrid::resolution() const {
+    return m_resolution;
+}
+
+int64_t OccupancyGrid::minX() const {
+    return m_minX;
+}
+
+int64_t OccupancyGrid::minY() const {
+    return m_minY;
+}
+
+void OccupancyGrid::clear() {
+    std::fill(m_cells.begin(), m_cells.end(), 0);
+}
@@ -0,0 +1,146 @@
+#include "PerfCounters.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+const char *perfEventName(PerfEvent event) {
+    static const char *names[] = {"cycles", "instructions", "L1d misses", "LLC misses", "branch misses", "dTLB misses"};
+    return names[static_cast<uint32_t>(event)];
+}
+
+static uint64_t cacheMiss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static int32_t openEvent(PerfEvent event, int32_t leader) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    switch (event) {
+        case PerfEvent::Cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfEvent::Instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfEvent::L1Misses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cacheMiss(PERF_COUNT_HW_CACHE_L1D);
+            break;
+        case PerfEvent::LlcMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cacheMiss(PERF_COUNT_HW_CACHE_LL);
+            break;
+        case PerfEvent::BranchMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PerfEvent::DtlbMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cacheMiss(PERF_COUNT_HW_CACHE_DTLB);
+            break;
+        default:
+            return -1;
+    }
+    // user space only, which perf_event_paranoid 2 allows without privileges
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int32_t>(syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+}
+
+
+PerfCounters &PerfCounters::thisThread() {
+    static thread_local PerfCounters counters;
+    return counters;
+}
+
+PerfCounters::PerfCounters() : m_leader(-1), m_opened(0) {
+    for (uint32_t i = 0; i < PERF_EVENT_COUNT; i++) {
+        m_fds[i] = -1;
+        m_slot[i] = -1;
+    }
+    m_leader = openEvent(PerfEvent::Cycles, -1);
+    if (m_leader < 0) {
+        static std::atomic<bool> warned(false);
+        if (!warned.exchange(true)) {
+            std::cerr << "Hardware performance counters unavailable: " << std::strerror(errno) << std::endl;
+        }
+        return;
+    }
+    m_fds[0] = m_leader;
+    m_slot[0] = m_opened++;
+    for (uint32_t i = 1; i < PERF_EVENT_COUNT; i++) {
+        m_fds[i] = openEvent(static_cast<PerfEvent>(i), m_leader);
+        if (m_fds[i] >= 0) {
+            m_slot[i] = m_opened++;
+        }
+    }
+    ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounters::~PerfCounters() {
+    for (uint32_t i = 0; i < PERF_EVENT_COUNT; i++) {
+        if (m_fds[i] >= 0) {
+            close(m_fds[i]);
+        }
+    }
+}
+
+bool PerfCounters::available() const {
+    return m_leader >= 0;
+}
+
+bool PerfCounters::available(PerfEvent event) const {
+    return m_slot[static_cast<uint32_t>(event)] >= 0;
+}
+
+void PerfCounters::read(PerfSample &sample) const {
+    sample.enabled = 0;
+    sample.running = 0;
+    for (uint32_t i = 0; i < PERF_EVENT_COUNT; i++) {
+        sample.counts[i] = 0;
+    }
+    sample.valid = false;
+    if (m_leader < 0) {
+        return;
+    }
+    // nr, time enabled, time running, one value per open event
+    uint64_t group[3 + PERF_EVENT_COUNT];
+    if (::read(m_leader, group, sizeof(group)) < static_cast<ssize_t>((3 + m_opened) * sizeof(uint64_t))) {
+        return;
+    }
+    sample.enabled = group[1];
+    sample.running = group[2];
+    for (uint32_t i = 0; i < PERF_EVENT_COUNT; i++) {
+        if (m_slot[i] >= 0) {
+            sample.counts[i] = group[3 + m_slot[i]];
+        }
+    }
+    sample.valid = true;
+}
+
+void PerfCounters::delta(const PerfSample &begin, const PerfSample &end, uint64_t *counts) {
+    for (uint32_t i = 0; i < PERF_EVENT_COUNT; i++) {
+        counts[i] = 0;
+    }
+    // the raw counts only grow, scaling the cumulative ones would not
+    if (!begin.valid || !end.valid || end.running <= begin.running) {
+        return;
+    }
+    const uint64_t enabled = end.enabled - begin.enabled;
+    const uint64_t running = end.running - begin.running;
+    for (uint32_t i = 0; i < PERF_EVENT_COUNT; i++) {
+        const uint64_t value = end.counts[i] >= begin.counts[i] ? end.counts[i] - begin.counts[i] : 0;
+        counts[i] = running < enabled ? static_cast<uint64_t>(static_cast<double>(value) * enabled / running) : value;
+    }
+}
@@ -16,6 +16,9 @@ Point::Point(float x, float y, float z, float measurement, float azimuth) : m_po
     m_noise = false;
     m_clustered = false;
     m_isGround = false;
+    m_outsideRoi = false;
+    m_tracked = false;
+    m_static = false;
 }
 
 
@@ -23,10 +26,10 @@ Point::Point() {
     m_visited = false;
     m_noise = false;
     m_clustered = false;
-}
-
-Eigen::Vector3f &Point::getVec() {
-    return m_point;
+    m_isGround = false;
+    m_outsideRoi = false;
+    m_tracked = false;
+    m_static = false;
 }
 
 void Point::setX(float x) {
@@ -37,8 +40,16 @@ void Point::setIsGround(bool isGround) {
     m_isGround = isGround;
 }
 
-bool Point::isGround() {
-    return m_isGround;
+void Point::setOutsideRoi(bool outside) {
+    m_outsideRoi = outside;
+}
+
+void Point::setTracked(bool tracked) {
+    m_tracked = tracked;
+}
+
+void Point::setStatic(bool isStatic) {
+    m_static = isStatic;
 }
 
 void Point::setY(float y) {
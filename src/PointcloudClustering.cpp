@@ -2,7 +2,12 @@
 
 #include "PointcloudClustering.h"
 #include <chrono>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgcodecs.hpp>
 
+#include "opendavinci/odcore/io/URL.h"
 #include "opendlv/scenario/SCNXArchive.h"
 #include "opendlv/scenario/SCNXArchiveFactory.h"
 #include "opendlv/scenario/ScenarioFactory.h"
@@ -37,30 +42,48 @@ using namespace opendlv::data::environment;
 
 PointcloudClustering::PointcloudClustering(const int32_t &argc, char **argv) :
         DataTriggeredConferenceClientModule(argc, argv, "PointcloudClustering"),
-        m_old_clusters(), m_obstacles(), gen(rd()) {};
+        m_pipeline(), m_adapter(), m_scenario(nullptr) {};
 
 PointcloudClustering::~PointcloudClustering() {}
 
 void PointcloudClustering::setUp() {
 
     cout << "This method is called before the component's body is executed." << endl;
+
+    // 0 - debug ; 1 - info ; 2 - warning ; 3 - error
+    Logger::instance().setLevel(static_cast<LogLevel>(std::max(0, std::min(getConfigValue<int>("pointcloudclustering.log.level", 1), 3))));
+    // comma separated track ids whose per track diagnostics are written, e.g. "54,93"
+    Logger::instance().setTrackFilter(utils::parseIdList(getConfigValue<string>("pointcloudclustering.log.tracks", ""),
+                                                         "pointcloudclustering.log.tracks"));
+
     cv::namedWindow("Lidar", cv::WINDOW_AUTOSIZE);
-    //const odcore::io::URL urlOfSCNXFile(getKeyValueConfiguration().getValue<string>("global.scenario"));
-    //core::wrapper::graph::DirectedGraph m_graph;
-    //opendlv::scenario::SCNXArchive &scnxArchive = opendlv::scenario::SCNXArchiveFactory::getInstance().getSCNXArchive(
-    //        urlOfSCNXFile);
-
-    //m_scenario = &scnxArchive.getScenario();
-
-    // Construct road network.
-    //opendlv::scenario::LaneVisitor lv(m_graph, *m_scenario);
-    //m_scenario->accept(lv);
-
-    //opendlv::data::scenario::Vertex3 origin = m_scenario->getHeader().getWGS84CoordinateSystem().getOrigin();
-    //cout << endl;
-    //cout << "Origin: \n" << origin;
-    //m_origin = new opendlv::data::environment::WGS84Coordinate(origin.getX(), origin.getY());
-    m_origin = new opendlv::data::environment::WGS84Coordinate(57.77284, 12.769964);
+    m_adapter.setOrigin(57.77284, 12.769964);
+
+    // Only cluster points on the lanes of the scenario, plus a margin in meters. The
+    // scenario also defines the origin of the cartesian frame then.
+    if (getConfigValue<int>("pointcloudclustering.roi", 0) != 0) {
+        try {
+            const odcore::io::URL urlOfSCNXFile(getKeyValueConfiguration().getValue<string>("global.scenario"));
+            opendlv::scenario::SCNXArchive &scnxArchive = opendlv::scenario::SCNXArchiveFactory::getInstance().getSCNXArchive(
+                    urlOfSCNXFile);
+            m_scenario = &scnxArchive.getScenario();
+
+            opendlv::data::scenario::Vertex3 origin = m_scenario->getHeader().getWGS84CoordinateSystem().getOrigin();
+            m_adapter.setOrigin(origin.getX(), origin.getY());
+
+            std::shared_ptr<RoiMask> mask = rasterizeScenario(*m_scenario, getConfigValue<float>("pointcloudclustering.roi.resolution", 0.5f),
+                                                              getConfigValue<double>("pointcloudclustering.roi.margin", 1.0));
+            if (mask) {
+                cout << "Region of interest: " << mask->count() << " of " << static_cast<uint64_t>(mask->width()) * mask->height() << " cells" << endl;
+                m_pipeline.setRoiMask(mask);
+            } else {
+                cerr << "Scenario has no lanes for the region of interest" << endl;
+            }
+        }
+        catch (string &exception) {
+            cerr << "Scenario could not be loaded: " << exception << endl;
+        }
+    }
     // We are using OpenDaVINCI's std::shared_ptr to automatically
     // release any acquired resources.
 
@@ -73,342 +96,151 @@ void PointcloudClustering::setUp() {
         cerr << "TCP-connection error: " << exception << endl;
     }
 
-}
+    // frames between two latency summaries, 0 disables them
+    m_statsInterval = getConfigValue<uint32_t>("pointcloudclustering.stats.interval", 100);
 
-void PointcloudClustering::tearDown() {
-    cout << "This method is called after the program flow returns from the component's body." << endl;
-}
+    // hardware performance counters per stage in the latency summaries, for profiling
+    StageTimers::instance().setCountingEvents(getConfigValue<int>("pointcloudclustering.stats.counters", 0) != 0);
 
-std::list<Point *> PointcloudClustering::getAllPointsNextToSlow(Eigen::Vector2d x, double delta) {
-    std::list<Point *> points;
-    for (uint32_t i = 0; i < m_cloudSize; i++) {
-        for (uint32_t offset = 0; offset < 16; offset++) {
-            if (m_points[i][offset].get2Distance(x[0], x[1]) < delta && !m_points[i][offset].isGround()) {
-                points.push_back(&m_points[i][offset]);
-            }
-        }
-    }
-    return points;
-}
-
-
-void PointcloudClustering::transform(CompactPointCloud &cpc) {
-    static const int maping[] = {-15, -13, -11, -9, -7, -5, -3, -1, 1, 3, 5, 7, 9, 11, 13, 15};
-    //static const int maping[] = {-15, -14,-13,-12, -11,-10, -9, -9,-7,-6, -5,-4, -3,-2, -1,0};//, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15};
-    std::string distances = cpc.getDistances();
-    m_cloudSize = distances.size() / 2 / 16;
-
-    m_startAzimuth = utils::deg2rad(cpc.getStartAzimuth() + m_heading);
-    m_endAzimuth = utils::deg2rad(cpc.getEndAzimuth() + m_heading);
-
-    vector<double> azimuth_range = utils::linspace(m_startAzimuth, m_endAzimuth, m_cloudSize);
-
-
-    const uint16_t *data = reinterpret_cast<const uint16_t *>(distances.c_str());
-
-    for (uint32_t i = 0; i < distances.size() / 2; i += 16) {
-        for (uint32_t offset = 0; offset < 16; offset++) {
-            float measurement = static_cast<float>(data[i + offset]) / 100.0;
-            float azimuth = static_cast<float>(azimuth_range[i / 16]);
-            float xy_range = measurement * cos(static_cast<float>(utils::deg2rad(maping[offset])));
-            float x = xy_range * sin(azimuth);
-            float y = xy_range * cos(azimuth);
-            float z = measurement * sin(static_cast<float>(utils::deg2rad(maping[offset])));
-            m_points[i / 16][offset] = Point(x, y, z, measurement, azimuth);
-            m_points[i / 16][offset].setIndex(i / 16, offset);
-            if (measurement <= 2.5) {
-                m_points[i / 16][offset].setIsGround(true);
-                m_points[i / 16][offset].setClustered(true);
-                m_points[i / 16][offset].setVisited(true);
-            }
+    // frame budget in milliseconds, 0 processes every frame in full
+    m_pipeline.setBudget(static_cast<int64_t>(getConfigValue<double>("pointcloudclustering.budget", 0) * 1000));
 
+    // Map of buildings and other permanent structure, kept across drives. Its points are
+    // not clustered; with static.learn the map is extended and saved on shutdown.
+    m_staticPath = getConfigValue<string>("pointcloudclustering.static.path", "");
+    if (!m_staticPath.empty()) {
+        std::shared_ptr<StaticMap> map = std::make_shared<StaticMap>(getConfigValue<float>("pointcloudclustering.static.resolution", 0.5f));
+        if (map->load(m_staticPath)) {
+            cout << "Static map: " << map->tileCount() << " tiles" << endl;
         }
+        m_staticLearn = getConfigValue<int>("pointcloudclustering.static.learn", 1) != 0;
+        m_staticMap = map;
+        m_pipeline.setStaticMap(map, m_staticLearn);
     }
 
-}
-
-void PointcloudClustering::segmentGroundByPlane() {
-    // devide measurement in sections
-    unsigned int sector_size = m_cloudSize / 30;
-    std::vector<Point *> minis;
-//    for (int sec = 0; sec < 12; sec += 1) {
-//        std::vector<Point *> tmp = utils::minZinSec(sector_size * sec, sector_size * (sec + 1), m_points);
-//        minis.insert(minis.end(), tmp.begin(), tmp.end());
-//    }
-
-
-    std::vector<Point *> tmp = utils::minZinSec(sector_size * 0 + sector_size / 2, sector_size * (0 + 1) + sector_size / 2, m_points);
-    minis.insert(minis.end(), tmp.begin(), tmp.end());
-    tmp = utils::minZinSec(sector_size * 12 + sector_size / 2, sector_size * (12 + 1) + sector_size / 2, m_points);
-    minis.insert(minis.end(), tmp.begin(), tmp.end());
-    tmp = utils::minZinSec(sector_size * 14 + sector_size / 2, sector_size * (14 + 1) + sector_size / 2, m_points);
-    minis.insert(minis.end(), tmp.begin(), tmp.end());
-    tmp = utils::minZinSec(sector_size * 28 + sector_size / 2, sector_size * (28 + 1) + sector_size / 2, m_points);
-    minis.insert(minis.end(), tmp.begin(), tmp.end());
-
-    // RANSAC
-    double besterror = 100000000;
-
-    std::uniform_int_distribution<> dis(0, ((minis.size() - 1)));
-
-    for (int probes = 0; probes < 50; probes++) {
-        std::vector<Point *> maybeinliers;
-        std::vector<Point *> alsoinliers;
-        // select 3 random points
-        maybeinliers.push_back(minis[dis(gen)]);
-        maybeinliers.push_back(minis[dis(gen)]);
-        maybeinliers.push_back(minis[dis(gen)]);
-
-        // Triange fitting
-//        int offset = dis(gen);
-//        maybeinliers.push_back(minis[offset]);
-//        maybeinliers.push_back(minis[offset + ((minis.size() - 1) / 3)]);
-//        maybeinliers.push_back(minis[offset + 2 * ((minis.size() - 1) / 3)]);
-
-
-        Plane maybemodel(maybeinliers);
-
-        for (auto &point : minis) {
-            if (std::find(maybeinliers.begin(), maybeinliers.end(), point) == maybeinliers.end()) {
-                float distance = std::abs(maybemodel.getDist(point->getVec()));
-                if (distance < 0.2) {
-                    alsoinliers.push_back(point);
-                }
-            }
-        }
-        if (alsoinliers.size() > 10) {
-            // this implies that we may have found a good model
-            // now test how good it is
-            Plane plane;
-            double err = plane.fitPlaneFromPoints(alsoinliers);
-            if (err < besterror && plane.distance > 1.9 && plane.distance < 2.1) {
-                besterror = err;
-                m_bestGroundModel = plane;
-            }
-        }
+    // 0 clusters every frame from scratch instead of assigning points to the predicted
+    // boxes of the tracks first
+    m_pipeline.setGuidedSegmentation(getConfigValue<int>("pointcloudclustering.guided", 1) != 0);
+    m_pipeline.setHibernation(getConfigValue<int>("pointcloudclustering.hibernate", 1) != 0);
+    // threads besides the conference thread, one less than there are cores by default
+    TaskScheduler::instance().setWorkerCount(getConfigValue<uint32_t>("pointcloudclustering.workers", TaskScheduler::instance().workerCount()));
+
+    // occupancy grid with cells per side, 0 disables it
+    m_pipeline.setOccupancyGrid(getConfigValue<uint32_t>("pointcloudclustering.grid", 0),
+                                getConfigValue<float>("pointcloudclustering.grid.resolution", 0.2f));
+
+    // comma separated sender stamps of the lidars, the first one is the primary lidar,
+    // e.g. "0,1" with pointcloudclustering.lidar.1.x/.y/.z/.yaw relative to lidar 0
+    std::vector<uint32_t> stamps;
+    std::vector<Extrinsics> sensors;
+    for (uint64_t lidar : utils::parseIdList(getConfigValue<string>("pointcloudclustering.lidars", ""), "pointcloudclustering.lidars")) {
+        const string prefix = "pointcloudclustering.lidar." + std::to_string(lidar);
+        Extrinsics extrinsics;
+        extrinsics.x = getConfigValue<double>(prefix + ".x", 0);
+        extrinsics.y = getConfigValue<double>(prefix + ".y", 0);
+        extrinsics.z = getConfigValue<double>(prefix + ".z", 0);
+        extrinsics.yaw = getConfigValue<double>(prefix + ".yaw", 0);
+        stamps.push_back(static_cast<uint32_t>(lidar));
+        sensors.push_back(extrinsics);
     }
-    cout << "BestErr: " << besterror << endl;
-    cout << "Groundplane Distance: " << m_bestGroundModel.distance << endl << "Vector: " << endl
-         << m_bestGroundModel.normal << endl;
-
-    for (uint32_t i = 0; i < m_cloudSize; i += 1) {
-        for (uint32_t offset = 0; offset < 16; offset++) {
-            //Eigen::Vector3f point = m_points[i][offset].getVec();
-            if (m_bestGroundModel.getDist(m_points[i][offset].getVec()) > -0.3) {
-                m_points[i][offset].setVisited(true);
-                m_points[i][offset].setClustered(true);
-                m_points[i][offset].setIsGround(true);
-            }
-        }
+    if (!sensors.empty()) {
+        m_pipeline.setSensors(sensors);
+        m_adapter.setSensors(stamps);
     }
 
-}
-
+    // Polar free space after the records of every frame, see FreeSpaceSection.
+    m_publishFreeSpace = getConfigValue<int>("pointcloudclustering.freespace", 0) != 0;
 
-void PointcloudClustering::segmentGroundByHeight() {
-    for (uint32_t i = 0; i < m_cloudSize; i += 1) {
-        for (uint32_t offset = 0; offset < 16; offset++) {
-            //Eigen::Vector3f point = m_points[i][offset].getVec();
-            if (m_points[i][offset].getZ() < -1.6) {
-                //cout<<"Delete"<<endl;
-                m_points[i][offset].setVisited(true);
-                m_points[i][offset].setClustered(true);
-                m_points[i][offset].setIsGround(true);
-            }
-        }
+    // Co-located consumers can read the latest frame from shared memory instead.
+    const string shmName = getConfigValue<string>("pointcloudclustering.shm.name", "");
+    if (!shmName.empty()) {
+        m_shm_labels = getConfigValue<int>("pointcloudclustering.shm.labels", 0) != 0;
+        const uint32_t labelCapacity = m_shm_labels ? 2000 * 16 : 0;
+        m_shm.reset(new SharedMemoryPublisher(shmName, sizeof(ObstacleFrameHeader) + 1024 * sizeof(ObstacleRecord) + sizeof(FreeSpaceSection),
+                                              labelCapacity));
     }
 
-}
-
-
-//void PointcloudClustering::trackObstacles(std::vector<Cluster> &clusters) {
-//
-//    if (m_old_clusters.size() == 0) {
-//        m_old_clusters.insert(m_old_clusters.begin(), clusters.begin(), clusters.end());
-//    } else {
-//        // correcting clusters with ego movement
-//        for (auto &old_cluster : m_old_clusters) {
-//            old_cluster.m_center[0] += m_movement_x;
-//            old_cluster.m_center[1] += m_movement_y;
-//        }
-//
-//        cout << "Searching Cluster.." << endl;
-//        for (auto &new_cluster : clusters) {
-//            double min_dist = 10000;
-//            Cluster *next = nullptr;
-//            for (auto &old_cluster : m_old_clusters) {
-//                if (!old_cluster.matched) {
-//                    double dist = new_cluster.get2Distance(old_cluster);
-//                    if (dist < min_dist) {
-//                        next = &old_cluster;
-//                        min_dist = dist;
-//                    }
-//                }
-//            }
-//            if (next != nullptr && min_dist < 3) {
-//                new_cluster.m_id = next->m_id;
-//                next->matched = false;
-//            }
-//        }
-//        m_old_clusters.clear();
-//        m_old_clusters.insert(m_old_clusters.begin(), clusters.begin(), clusters.end());
-//    }
-//
-//
-//    if (m_obstacles.size() == 0) {
-//        for (auto &cluster : clusters) {
-//            m_obstacles.push_back(LidarObstacle(&cluster, m_current_timestamp));
-//        }
-//    }
-//
-//    for (auto &cluster : clusters) {
-//
-//        unsigned int current_id = cluster.m_id;
-//        LidarObstacle *tmp = nullptr;
-//        for (auto &obst : m_obstacles) {
-//            if (obst.m_initial_id == current_id) {
-//                tmp = &obst;
-//                obst.clusterCandidates.push_back(&cluster);
-//            }
-//        }
-//        if (tmp == nullptr) {
-//            m_obstacles.push_back(LidarObstacle(&cluster, m_current_timestamp));
-//        }
-//    }
-//
-//    for (auto &obst : m_obstacles) {
-//        obst.refresh(m_movement_x, m_movement_y, m_current_timestamp, m_itCount);
-//    }
-//
-//    std::cout<<"------------------------------------"<<m_obstacles.size()<<endl;
-//    m_obstacles.remove_if([] (LidarObstacle &i) {
-//        return i.confidenceIsZero();
-//    });
-//
-//
-//
-//    std::cout<<"------------------------------------"<<m_obstacles.size()<<endl;
-//
-//}
-
-void PointcloudClustering::trackObstacles(std::vector<Cluster> &clusters) {
-
-    for (auto &cluster : clusters) {
-        //cluster.calcRectangle();
-        cluster.mean();
-    }
-
-    for (auto &obst : m_obstacles) {
-        obst.m_filter.predict(obst.getDt(m_current_timestamp));
-        double x = obst.m_filter.m_x[0] + m_movement_x;
-        double y = obst.m_filter.m_x[1] + m_movement_y;
-        for (auto &cluster : clusters) {
-            if (!cluster.assigned && cluster.get2Distance(x, y) < 3) {
-                cluster.assigned = true;
-                obst.clusterCandidates.push_back(&cluster);
-            }
+    // Compressed archive of the whole session, replayable with pointcloud_cluster-replay.
+    const string archivePath = getConfigValue<string>("pointcloudclustering.archive.path", "");
+    if (!archivePath.empty()) {
+        std::shared_ptr<SweepArchiveWriter> archive = std::make_shared<SweepArchiveWriter>(archivePath);
+        if (archive->isOpen()) {
+            m_pipeline.setArchive(archive);
         }
-        obst.refresh(m_movement_x, m_movement_y, m_current_timestamp, m_itCount);
     }
-    for (auto &cluster : clusters) {
-        if (!cluster.assigned) {
 
-            m_obstacles.push_back(LidarObstacle(&cluster, m_current_timestamp, m_id_counter++));
-            cluster.assigned = true;
+    // Keeps the last seconds of input and output in a ring file for the post-mortem,
+    // see tools/extract.cpp.
+    const string recorderPath = getConfigValue<string>("pointcloudclustering.recorder.path", "");
+    if (!recorderPath.empty()) {
+        const double seconds = getConfigValue<double>("pointcloudclustering.recorder.seconds", 30);
+        m_recorder = std::make_shared<FlightRecorder>(recorderPath,
+                                                      static_cast<uint64_t>(seconds * FlightRecorder::bytesPerSecond(m_pipeline.sensorCount())));
+        if (m_recorder->isOpen()) {
+            m_pipeline.setRecorder(m_recorder);
+        } else {
+            m_recorder.reset();
         }
     }
 
-    std::cout << "------------------------------------" << m_obstacles.size() << endl;
-    m_obstacles.remove_if([](LidarObstacle &i) {
-        return i.confidenceIsZero();
-    });
-
-
-    std::cout << "------------------------------------" << m_obstacles.size() << endl;
-
+    // Real-time profile, e.g. rt.cores=2,3,4 rt.priority=50 rt.lock=1. The processing
+    // thread is set up with the first container, since the conference may deliver them
+    // on another thread than this one.
+    m_realtime.cores = RealtimeProfile::parseCores(getConfigValue<string>("pointcloudclustering.rt.cores", ""));
+    m_realtime.priority = getConfigValue<int>("pointcloudclustering.rt.priority", 0);
+    m_realtime.lockMemory = getConfigValue<int>("pointcloudclustering.rt.lock", 0) != 0;
+    m_realtime.applyToProcess();
+    m_pipeline.prefault();
+}
 
+void PointcloudClustering::tearDown() {
+    cout << "This method is called after the program flow returns from the component's body." << endl;
+    // closes the archive with its index
+    m_pipeline.setArchive(nullptr);
+    if (m_staticMap && m_staticLearn) {
+        m_staticMap->save(m_staticPath);
+    }
+    Logger::instance().flush();
 }
 
 
 void PointcloudClustering::nextContainer(Container &c) {
-    if (c.getDataType() == opendlv::core::sensors::applanix::Grp1Data::ID()) {
-        opendlv::core::sensors::applanix::Grp1Data imu = c.getData<opendlv::core::sensors::applanix::Grp1Data>();
-        //cout << imu.getHeading() << endl;
-        m_lat = imu.getLat();
-        m_lon = imu.getLon();
-        m_heading = imu.getHeading();
-
-
-        Point3 cart = m_origin->transform(opendlv::data::environment::WGS84Coordinate(imu.getLat(), imu.getLon()));
-
-
-        if (imu.getRoll() > 1233) {
-            m_x = imu.getLat();
-            m_y = imu.getLon();
-        } else {
-            m_x = cart.getX();
-            m_y = cart.getY();
-        }
-
-
-        //std::cout<<"X: "<<m_x<<std::endl;
-        //std::cout<<"Y: "<<m_y<<std::endl;
-
-        if (!m_imu_updateted) {
-            m_old_x = m_x;
-            m_old_y = m_y;
-            m_imu_updateted = true;
-        }
-
-
-
-
-
-        //cout << "CartesianPos: " << cart << endl;
-        //cv::Mat image(1000, 1000, CV_8UC3, cv::Scalar(0, 0, 0));
-        //cv::circle(image, cv::Point(cart.getX() + 500, (-1 * cart.getY()) + 500), 2, cv::Scalar(0, 0, 255));
-
+    if (!m_realtimeApplied) {
+        m_realtime.applyToThisThread();
+        m_realtimeApplied = true;
     }
-
-    if (c.getDataType() == CompactPointCloud::ID()) {
-        cout << "-----------------------------" << endl;
-        cout << "-----RUN: " << m_itCount << endl;
-
-        m_movement_x = m_x - m_old_x;
-        m_movement_y = m_y - m_old_y;
-        std::cout << "m_movement_x: " << m_movement_x << endl;
-        std::cout << "m_movement_y: " << m_movement_y << endl;
-
-        m_old_x = m_x;
-        m_old_y = m_y;
-
-
-        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-        m_current_timestamp = c.getSentTimeStamp();
-        CompactPointCloud cpc = c.getData<CompactPointCloud>();
-        transform(cpc);
-        segmentGroundByHeight();
-        //segmentGroundByPlane();
-
-
-        DbScan dbScan = DbScan(m_points, m_cloudSize);
-
-        std::vector<Cluster> clusters;
-        dbScan.getClusters(clusters);
-
-        trackObstacles(clusters);
-
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    if (m_adapter.feed(c, m_pipeline)) {
 #ifdef VIS
+        std::list<LidarObstacle> &obstacles = m_pipeline.obstacles();
+        Point (&points)[2000][16] = m_pipeline.points();
+        const uint32_t cloudSize = m_pipeline.cloudSize();
+        std::vector<Cluster> &clusters = m_pipeline.clusters();
+        const double movement_x = m_pipeline.movementX();
+        const double movement_y = m_pipeline.movementY();
 
         const static int res = 1000;
         const static int zoom = 8;
 
         cv::Mat image(res, res, CV_8UC3, cv::Scalar(0, 0, 0));
 
+        const OccupancyGrid *grid = m_pipeline.occupancyGrid();
+        if (grid != nullptr) {
+            const int cell = std::max(1, static_cast<int>(grid->resolution() * zoom));
+            for (int y = 0; y < res; y += cell) {
+                for (int x = 0; x < res; x += cell) {
+                    const double wx = m_pipeline.egoX() + (x - res / 2) / static_cast<double>(zoom);
+                    const double wy = m_pipeline.egoY() - (y - res / 2) / static_cast<double>(zoom);
+                    if (grid->logOdds(wx, wy) > 0) {
+                        cv::rectangle(image, cv::Rect(x, y, cell, cell), cv::Scalar(64, 64, 64), -1);
+                    }
+                }
+            }
+        }
 
-        for (uint32_t i = 0; i < m_cloudSize; i++) {
+        for (uint32_t i = 0; i < cloudSize; i++) {
             for (int j = 0; j < 16; j++) {
-                Point *point = &m_points[i][j];
+                Point *point = &points[i][j];
                 int x = static_cast<int>(point->getX() * zoom) + res / 2;
                 int y = -static_cast<int>(point->getY() * zoom) + res / 2;
                 if ((x < res) && (y < res) && (y >= 0) && (x >= 0)) {
@@ -432,10 +264,10 @@ void PointcloudClustering::nextContainer(Container &c) {
 
 
         if (true) {
-            cv::circle(image, cv::Point((m_x - m_old_x) * zoom + res / 2, -(m_y - m_old_y) * zoom + res / 2), 4, cv::Scalar(128, 255, 128), 2, 8, 0);
-            for (auto &obst : m_obstacles) {
+            cv::circle(image, cv::Point(res / 2, res / 2), 4, cv::Scalar(128, 255, 128), 2, 8, 0);
+            for (auto &obst : obstacles) {
                 if (true || obst.m_initial_id == 54) {
-                    if (obst.m_confidence >= 2) {
+                    if (obst.isConfirmed()) {
 
                         if (obst.m_rectangle_center[0] != 0 && obst.m_rectangle_center[1] != 0) {
 
@@ -493,7 +325,7 @@ void PointcloudClustering::nextContainer(Container &c) {
                 }
 
             }
-            //m_obstacles.clear();
+            //obstacles.clear();
 
             for (auto &cluster : clusters) {
 //            auto hull = utils::convex_hull(cluster);
@@ -550,7 +382,7 @@ void PointcloudClustering::nextContainer(Container &c) {
                         cv::Scalar(255, 255, 255), 1, 8, 0, 0.1);
 
 
-        cv::arrowedLine(image, cv::Point(res / 2, res / 2), cv::Point(m_movement_x * 10 * zoom + res / 2, -m_movement_y * 10 * zoom + res / 2),
+        cv::arrowedLine(image, cv::Point(res / 2, res / 2), cv::Point(movement_x * 10 * zoom + res / 2, -movement_y * 10 * zoom + res / 2),
                         cv::Scalar(255, 0, 255), 1, 8, 0, 0.1);
 
 
@@ -560,11 +392,11 @@ void PointcloudClustering::nextContainer(Container &c) {
 
 
 
-        ss << "../images/img" << m_itCount++ << ".png";
+        ss << "../images/img" << m_pipeline.frameIndex() << ".png";
         cv::imwrite(ss.str(), image);
 
 
-//        for (auto &obst : m_obstacles) {
+//        for (auto &obst : obstacles) {
 //            opendlv::core::sensors::applanix::obstacles odvd_obst;
 //            odvd_obst.setObjId(obst.m_initial_id);
 //            odvd_obst.setSpeed(obst.m_filter.m_x[3]);
@@ -583,39 +415,53 @@ void PointcloudClustering::nextContainer(Container &c) {
 
         cv::waitKey(1);
 #endif
-        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-        stringstream test;
-        for (auto &obst : m_obstacles) {
-            if (obst.m_confidence >= 2) {
-                opendlv::core::sensors::applanix::obstacles tcp_obst;
-                tcp_obst.setPos_x(obst.m_filter.m_x[0]);
-                tcp_obst.setPos_y(obst.m_filter.m_x[1]);
-                tcp_obst.setTheta(obst.m_filter.m_x[2]);
-                tcp_obst.setSpeed(obst.m_filter.m_x[3]);
-                tcp_obst.setYaw_rate(obst.m_filter.m_x[4]);
-                tcp_obst.setType(obst.m_best_type);
-                tcp_obst.setObjId(obst.m_initial_id);
-                //cout<<obst.m_initial_id<<endl;
-                tcp_obst << test;
-                test << "::-::";
+        {
+            ScopedStageTimer timer(Stage::Serialize);
+            m_frameWriter.begin(m_pipeline.timestamp(), m_pipeline.degradations());
+            m_pipeline.confirmedTracks(m_records);
+            for (auto &record : m_records) {
+                m_frameWriter.add(record);
+            }
+            if (m_publishFreeSpace) {
+                m_pipeline.freeSpace(m_freeSpace);
+                m_frameWriter.addFreeSpace(m_freeSpace);
+            }
+            if ((m_shm && m_shm_labels) || m_recorder) {
+                m_pipeline.labelPoints(m_labels);
             }
         }
 
-        try {
-            connection->send("startHere::" + test.str());
-
-        }
-        catch (string &exception) {
-            cerr << "Data could not be sent: " << exception << endl;
-        }
+        {
+            ScopedStageTimer timer(Stage::Send);
+            if (m_shm) {
+                if (m_shm_labels) {
+                    m_shm->publish(m_frameWriter.data(), m_labels.data(), m_pipeline.cloudSize(), 16);
+                } else {
+                    m_shm->publish(m_frameWriter.data(), nullptr, 0, 0);
+                }
+            }
 
-        double millis = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000.0;
-        millis += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 1000000.0;
+            try {
+                connection->send(m_frameWriter.data());
 
+            }
+            catch (string &exception) {
+                cerr << "Data could not be sent: " << exception << endl;
+            }
+        }
 
-        std::cout << "Time difference = " << millis << std::endl;
+        if (m_recorder) {
+            m_recorder->recordLabels(m_pipeline.timestamp(), m_labels.data(), m_pipeline.cloudSize(), 16);
+            m_recorder->recordTracks(m_pipeline.timestamp(), m_frameWriter.data());
+        }
 
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        StageTimers::instance().endFrame(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+        if (m_statsInterval > 0 && ++m_statsFrames % m_statsInterval == 0) {
+            StageTimers::instance().report();
+        }
 
     }
 
 }
+
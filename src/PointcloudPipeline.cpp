@@ -0,0 +1,466 @@
+#include "PointcloudPipeline.h"
+#include <algorithm>
+#include <chrono>
+
+#include "Logger.h"
+#include "StageTimer.h"
+#include "SharedMemoryChannel.h"
+#include "TaskScheduler.h"
+
+
+using namespace std;
+
+// tracks per task of the scheduler
+static const uint32_t TRACK_GRAIN = 8;
+// meters between a cluster and the expected position of a track for an association
+static const double GATE_DISTANCE = 3;
+// clusters and tracks that prefault() reserves for
+static const uint32_t PREFAULT_CLUSTERS = 1024;
+static const uint32_t PREFAULT_TRACKS = 512;
+
+
+PointcloudPipeline::PointcloudPipeline() :
+        m_sensors(), m_sensor_clusters(), m_clusters(), m_boxes(), m_box_tracks(), m_sensor_guided(), m_guided_tracks(), m_obstacles(), m_tracks(), m_gate_index(), m_expected_x(), m_expected_y(), m_gated(), m_confirmed_index(), m_grid(), m_roi(), m_static(), m_recorder(), m_archive() {
+    setSensors(std::vector<Extrinsics>(1));
+}
+
+PointcloudPipeline::~PointcloudPipeline() {}
+
+void PointcloudPipeline::setBudget(int64_t budget) {
+    m_budget.setBudget(budget);
+}
+
+void PointcloudPipeline::setBudgetCosts(const double *costs) {
+    m_budget.setVirtualCosts(costs);
+}
+
+void PointcloudPipeline::setGroundModel(GroundModel model) {
+    m_groundModel = model;
+    for (auto &sensor : m_sensors) {
+        sensor->setGroundModel(model);
+    }
+}
+
+void PointcloudPipeline::setSensors(const std::vector<Extrinsics> &sensors) {
+    // the clusters point into the front ends
+    m_clusters.clear();
+    m_sensors.clear();
+    for (auto &extrinsics : sensors) {
+        m_sensors.push_back(std::unique_ptr<SensorFrontEnd>(new SensorFrontEnd(extrinsics)));
+        m_sensors.back()->setGroundModel(m_groundModel);
+    }
+    m_sensor_clusters.resize(m_sensors.size());
+    m_sensor_guided.resize(m_sensors.size());
+}
+
+uint32_t PointcloudPipeline::sensorCount() const {
+    return m_sensors.size();
+}
+
+void PointcloudPipeline::setOccupancyGrid(uint32_t size, float resolution) {
+    m_grid.reset(size > 0 ? new OccupancyGrid(size, resolution) : nullptr);
+}
+
+const OccupancyGrid *PointcloudPipeline::occupancyGrid() const {
+    return m_grid.get();
+}
+
+void PointcloudPipeline::setRoiMask(std::shared_ptr<const RoiMask> mask) {
+    m_roi = mask;
+}
+
+void PointcloudPipeline::setStaticMap(std::shared_ptr<StaticMap> map, bool learn) {
+    m_static = map;
+    m_learn_static = learn;
+}
+
+void PointcloudPipeline::setGuidedSegmentation(bool guided) {
+    m_guided = guided;
+}
+
+void PointcloudPipeline::setHibernation(bool hibernation) {
+    m_hibernation = hibernation;
+}
+
+void PointcloudPipeline::setRecorder(std::shared_ptr<FlightRecorder> recorder) {
+    m_recorder = recorder;
+}
+
+void PointcloudPipeline::setArchive(std::shared_ptr<SweepArchiveWriter> archive) {
+    m_archive = archive;
+}
+
+Point (&PointcloudPipeline::points())[2000][16] {
+    return m_sensors[0]->points();
+}
+
+unsigned int PointcloudPipeline::cloudSize() const {
+    return m_sensors[0]->cloudSize();
+}
+
+std::vector<Cluster> &PointcloudPipeline::clusters() {
+    return m_clusters;
+}
+
+std::list<LidarObstacle> &PointcloudPipeline::obstacles() {
+    return m_obstacles;
+}
+
+void PointcloudPipeline::confirmedTracks(std::vector<ObstacleRecord> &records) const {
+    records.clear();
+    for (auto &obst : m_obstacles) {
+        if (obst.isConfirmed()) {
+            ObstacleRecord record;
+            record.id = obst.m_initial_id;
+            record.x = static_cast<float>(obst.m_filter.m_x[0]);
+            record.y = static_cast<float>(obst.m_filter.m_x[1]);
+            record.theta = static_cast<float>(obst.m_filter.m_x[2]);
+            record.speed = static_cast<float>(obst.m_filter.m_x[3]);
+            record.yawRate = static_cast<float>(obst.m_filter.m_x[4]);
+            record.width = obst.m_best_width;
+            record.length = obst.m_best_length;
+            record.type = static_cast<uint8_t>(obst.m_best_type);
+            record.reserved[0] = record.reserved[1] = record.reserved[2] = 0;
+            records.push_back(record);
+        }
+    }
+}
+
+const TrackIndex &PointcloudPipeline::confirmedIndex() const {
+    return m_confirmed_index;
+}
+
+void PointcloudPipeline::freeSpace(FreeSpaceSection &freeSpace) const {
+    std::fill(freeSpace.range, freeSpace.range + FREE_SPACE_BINS, FREE_SPACE_NO_RETURN);
+    for (auto &sensor : m_sensors) {
+        sensor->addFreeSpace(freeSpace);
+    }
+}
+
+int64_t PointcloudPipeline::timestamp() const {
+    return m_current_timestamp;
+}
+
+uint16_t PointcloudPipeline::degradations() const {
+    return m_budget.degradations();
+}
+
+double PointcloudPipeline::movementX() const {
+    return m_movement_x;
+}
+
+double PointcloudPipeline::movementY() const {
+    return m_movement_y;
+}
+
+double PointcloudPipeline::egoX() const {
+    return m_x;
+}
+
+double PointcloudPipeline::egoY() const {
+    return m_y;
+}
+
+int PointcloudPipeline::frameIndex() const {
+    return m_itCount - 1;
+}
+
+
+void PointcloudPipeline::predictTracks() {
+    m_boxes.clear();
+    m_box_tracks.clear();
+    forEachTrack([&](LidarObstacle &obst) {
+        obst.predict(m_movement_x, m_movement_y, m_current_timestamp);
+    });
+    for (auto &obst : m_obstacles) {
+        if (m_guided && obst.m_has_box) {
+            m_boxes.push_back(obst.m_box);
+            m_box_tracks.push_back(&obst);
+        }
+    }
+}
+
+void PointcloudPipeline::trackObstacles(std::vector<Cluster> &clusters) {
+    ScopedStageTimer timer(Stage::Associate);
+
+    for (auto &cluster : clusters) {
+        //cluster.calcRectangle();
+        cluster.mean();
+    }
+    for (uint32_t i = 0; i < m_guided_tracks.size(); i++) {
+        clusters[i].assigned = true;
+        m_guided_tracks[i]->clusterCandidates.push_back(&clusters[i]);
+    }
+
+    // Each cluster goes to the first track in m_obstacles that gates it, as if every
+    // track in turn took all clusters left in its gate.
+    m_tracks.clear();
+    m_expected_x.clear();
+    m_expected_y.clear();
+    m_gate_index.clear();
+    for (auto &obst : m_obstacles) {
+        double x, y;
+        obst.expectedPosition(m_movement_x, m_movement_y, x, y);
+        m_gate_index.add(m_tracks.size(), static_cast<float>(x), static_cast<float>(y));
+        m_tracks.push_back(&obst);
+        m_expected_x.push_back(x);
+        m_expected_y.push_back(y);
+    }
+    m_gate_index.build();
+    for (auto &cluster : clusters) {
+        if (cluster.assigned) {
+            continue;
+        }
+        // a little wider than the gate, which is checked exactly below
+        m_gate_index.radius(static_cast<float>(cluster.m_center[0]), static_cast<float>(cluster.m_center[1]), GATE_DISTANCE + 0.01, m_gated);
+        for (auto t : m_gated) {
+            if (cluster.get2Distance(m_expected_x[t], m_expected_y[t]) < GATE_DISTANCE && m_tracks[t]->overlaps(cluster, m_movement_x, m_movement_y)) {
+                cluster.assigned = true;
+                m_tracks[t]->clusterCandidates.push_back(&cluster);
+                break;
+            }
+        }
+    }
+    // the tracks only share the clusters, which are not changed any more
+    const bool refit = !(m_budget.degradations() & FRAME_SKIPPED_REFIT);
+    forEachTrack([&](LidarObstacle &obst) {
+        obst.refresh(m_movement_x, m_movement_y, m_current_timestamp, m_itCount, refit, m_hibernation);
+    });
+    for (auto &cluster : clusters) {
+        if (!cluster.assigned) {
+
+            m_obstacles.push_back(LidarObstacle(&cluster, m_current_timestamp, m_id_counter++));
+            cluster.assigned = true;
+        }
+    }
+
+    logMessage(LogLevel::Debug, "Tracks before pruning:", m_obstacles.size());
+    m_obstacles.remove_if([](LidarObstacle &i) {
+        return i.confidenceIsZero();
+    });
+
+
+    logMessage(LogLevel::Debug, "Tracks after pruning:", m_obstacles.size());
+
+    m_confirmed_index.clear();
+    uint32_t confirmed = 0;
+    for (auto &obst : m_obstacles) {
+        if (obst.isConfirmed()) {
+            m_confirmed_index.add(confirmed++, static_cast<float>(obst.m_filter.m_x[0]), static_cast<float>(obst.m_filter.m_x[1]));
+        }
+    }
+    m_confirmed_index.build();
+
+
+}
+
+
+void PointcloudPipeline::labelPoints(std::vector<uint16_t> &labels) {
+    const SensorFrontEnd &primary = *m_sensors[0];
+    Point (&points)[2000][16] = m_sensors[0]->points();
+    labels.resize(2000 * 16);
+    for (uint32_t i = 0; i < primary.cloudSize(); i++) {
+        for (uint32_t offset = 0; offset < 16; offset++) {
+            labels[i * 16 + offset] = points[i][offset].isGround() ? LABEL_GROUND :
+                                      points[i][offset].isOutsideRoi() ? LABEL_OUTSIDE_ROI :
+                                      points[i][offset].isStatic() ? LABEL_STATIC : LABEL_NONE;
+        }
+    }
+    for (uint32_t n = 0; n < m_clusters.size(); n++) {
+        uint16_t label = static_cast<uint16_t>(std::min<uint32_t>(n + LABEL_FIRST_CLUSTER, LABEL_STATIC - 1));
+        for (auto &point : m_clusters[n].m_cluster) {
+            if (primary.owns(point)) {
+                labels[point->getIndex() * 16 + point->getLayer()] = label;
+            }
+        }
+    }
+}
+
+
+void PointcloudPipeline::prefault() {
+    for (auto &sensor : m_sensors) {
+        sensor->prefault(PREFAULT_TRACKS);
+    }
+    m_clusters.reserve(PREFAULT_CLUSTERS);
+    for (auto &clusters : m_sensor_clusters) {
+        clusters.reserve(PREFAULT_CLUSTERS);
+    }
+    for (auto &guided : m_sensor_guided) {
+        guided.reserve(PREFAULT_TRACKS);
+    }
+    m_boxes.reserve(PREFAULT_TRACKS);
+    m_box_tracks.reserve(PREFAULT_TRACKS);
+    m_guided_tracks.reserve(PREFAULT_TRACKS);
+    m_tracks.reserve(PREFAULT_TRACKS);
+    m_expected_x.reserve(PREFAULT_TRACKS);
+    m_expected_y.reserve(PREFAULT_TRACKS);
+    m_gated.reserve(PREFAULT_TRACKS);
+}
+
+void PointcloudPipeline::addPose(const Pose &pose) {
+    if (m_recorder) {
+        m_recorder->recordPose(pose);
+    }
+    if (m_archive) {
+        m_archive->addPose(pose);
+    }
+    m_poses.push(pose);
+}
+
+void PointcloudPipeline::forEachSensor(const std::function<void(uint32_t)> &task) {
+    TaskScheduler::instance().parallelFor(m_sensors.size(), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            task(i);
+        }
+    });
+}
+
+void PointcloudPipeline::forEachTrack(const std::function<void(LidarObstacle &)> &task) {
+    m_tracks.clear();
+    for (auto &obst : m_obstacles) {
+        m_tracks.push_back(&obst);
+    }
+    TaskScheduler::instance().parallelFor(m_tracks.size(), TRACK_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            task(*m_tracks[i]);
+        }
+    });
+}
+
+bool PointcloudPipeline::process(const Sweep &sweep) {
+    if (sweep.sensor >= m_sensors.size()) {
+        return false;
+    }
+    if (m_recorder) {
+        m_recorder->recordSweep(sweep);
+    }
+    if (m_archive) {
+        m_archive->addSweep(sweep);
+    }
+    if (sweep.sensor != 0) {
+        m_sensors[sweep.sensor]->store(sweep);
+        return false;
+    }
+
+    logMessage(LogLevel::Debug, "RUN:", m_itCount);
+
+    // ego motion between the timestamps of this and the previous sweep
+    const int64_t sweepTimestamp = sweep.timestamp;
+    const Pose sweepPose = m_poses.interpolate(sweepTimestamp);
+    m_x = sweepPose.x;
+    m_y = sweepPose.y;
+    m_heading = sweepPose.heading;
+    if (!m_imu_updateted && !m_poses.empty()) {
+        m_old_x = m_x;
+        m_old_y = m_y;
+        m_imu_updateted = true;
+    }
+
+    m_movement_x = m_x - m_old_x;
+    m_movement_y = m_y - m_old_y;
+    logMessage(LogLevel::Debug, "movement:", m_movement_x, m_movement_y);
+
+    m_old_x = m_x;
+    m_old_y = m_y;
+
+
+    m_current_timestamp = sweepTimestamp;
+    m_budget.begin();
+    if (m_budget.isAtRisk(FrameBudget::DECODE)) {
+        m_budget.degrade(FRAME_DECIMATED);
+    }
+
+    m_budget.beginStep(FrameBudget::DECODE);
+    if (m_static) {
+        m_static->moveTo(m_x, m_y);
+    }
+    forEachSensor([&](uint32_t i) {
+        {
+            ScopedStageTimer timer(Stage::Decode);
+            if (i == 0) {
+                m_sensors[i]->decode(sweep, m_poses, sweepPose);
+            } else {
+                m_sensors[i]->decodeStored(m_poses, sweepPose);
+            }
+        }
+        {
+            ScopedStageTimer timer(Stage::Ground);
+            m_sensors[i]->segmentGround();
+            if (m_roi) {
+                m_sensors[i]->applyMask(*m_roi);
+            }
+            if (m_static) {
+                m_sensors[i]->applyStaticMap(*m_static);
+            }
+        }
+    });
+    uint64_t points = 0;
+    for (auto &sensor : m_sensors) {
+        points += sensor->cloudSize() * 16;
+    }
+    m_budget.endStep(FrameBudget::DECODE, points);
+
+    predictTracks();
+
+
+    if (m_budget.isAtRisk(FrameBudget::CLUSTER)) {
+        m_budget.degrade(FRAME_NARROW_WINDOW);
+    }
+    m_budget.beginStep(FrameBudget::CLUSTER);
+    const int stride = (m_budget.degradations() & FRAME_DECIMATED) ? 2 : 1;
+    const int window = (m_budget.degradations() & FRAME_NARROW_WINDOW) ? 2 : 5;
+    forEachSensor([&](uint32_t i) {
+        {
+            ScopedStageTimer timer(Stage::Presegment);
+            m_sensors[i]->presegment(m_boxes, m_sensor_guided[i]);
+        }
+        ScopedStageTimer timer(Stage::Cluster);
+        m_sensor_clusters[i].clear();
+        m_sensors[i]->cluster(m_sensor_clusters[i], stride, window);
+    });
+    // the clusters of the boxes first, in the order of m_guided_tracks
+    m_clusters.clear();
+    m_guided_tracks.clear();
+    for (uint32_t b = 0; b < m_boxes.size(); b++) {
+        for (auto &guided : m_sensor_guided) {
+            if (!guided[b].m_cluster.empty()) {
+                m_clusters.push_back(std::move(guided[b]));
+                m_guided_tracks.push_back(m_box_tracks[b]);
+            }
+        }
+    }
+    for (auto &clusters : m_sensor_clusters) {
+        std::move(clusters.begin(), clusters.end(), std::back_inserter(m_clusters));
+    }
+    if (m_grid) {
+        ScopedStageTimer timer(Stage::Grid);
+        m_grid->moveTo(m_x, m_y);
+        // the hits of all lidars first, the free space of one must not clear those of another
+        for (auto &sensor : m_sensors) {
+            m_grid->integrateHits(sensor->points(), sensor->cloudSize());
+        }
+        for (auto &sensor : m_sensors) {
+            m_grid->integrateFreeSpace(sensor->points(), sensor->cloudSize(), sensor->originX(), sensor->originY());
+        }
+    }
+    if (m_static && m_learn_static && !m_poses.empty()) {
+        ScopedStageTimer timer(Stage::Grid);
+        for (auto &sensor : m_sensors) {
+            sensor->observeStructure(*m_static);
+        }
+        m_static->endFrame();
+    }
+    m_budget.endStep(FrameBudget::CLUSTER, points / stride * window);
+
+    if (m_budget.isAtRisk(FrameBudget::TRACK)) {
+        m_budget.degrade(FRAME_SKIPPED_REFIT);
+    }
+    m_budget.beginStep(FrameBudget::TRACK);
+    trackObstacles(m_clusters);
+    m_budget.endStep(FrameBudget::TRACK, m_clusters.size() + m_obstacles.size());
+    if (m_budget.degradations() != 0) {
+        logMessage(LogLevel::Info, "Frame degraded:", m_budget.degradations(), m_budget.elapsed());
+    }
+    m_itCount++;
+    return true;
+}
@@ -0,0 +1,115 @@
+#include "PoseBuffer.h"
+#include <cmath>
+
+
+PoseBuffer::PoseBuffer() : m_head(0), m_size(0) {}
+
+void PoseBuffer::push(const Pose &pose) {
+    if (m_size > 0 && pose.timestamp <= newest().timestamp) {
+        return;
+    }
+    m_poses[m_head] = pose;
+    m_head = (m_head + 1) % CAPACITY;
+    if (m_size < CAPACITY) {
+        m_size++;
+    }
+}
+
+bool PoseBuffer::empty() const {
+    return m_size == 0;
+}
+
+const Pose &PoseBuffer::newest() const {
+    return at(m_size - 1);
+}
+
+const Pose &PoseBuffer::at(uint32_t i) const {
+    // i = 0 is the oldest pose
+    return m_poses[(m_head + CAPACITY - m_size + i) % CAPACITY];
+}
+
+uint32_t PoseBuffer::lowerBound(int64_t timestamp) const {
+    uint32_t low = 0;
+    uint32_t high = m_size;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (at(mid).timestamp < timestamp) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+Pose PoseBuffer::lerp(const Pose &a, const Pose &b, int64_t timestamp) {
+    double t = static_cast<double>(timestamp - a.timestamp) / static_cast<double>(b.timestamp - a.timestamp);
+    // shortest way around the circle
+    double dheading = std::fmod(b.heading - a.heading + 540.0, 360.0) - 180.0;
+
+    Pose pose;
+    pose.timestamp = timestamp;
+    pose.x = a.x + (b.x - a.x) * t;
+    pose.y = a.y + (b.y - a.y) * t;
+    pose.heading = std::fmod(a.heading + dheading * t + 360.0, 360.0);
+    return pose;
+}
+
+Pose PoseBuffer::interpolate(int64_t timestamp) const {
+    Pose pose;
+    interpolate(timestamp, timestamp, 1, &pose);
+    return pose;
+}
+
+void PoseBuffer::interpolate(int64_t begin, int64_t end, uint32_t count, Pose *out) const {
+    if (m_size == 0) {
+        for (uint32_t i = 0; i < count; i++) {
+            out[i] = Pose{0, 0, 0, 0};
+        }
+        return;
+    }
+
+    uint32_t next = lowerBound(begin);
+    for (uint32_t i = 0; i < count; i++) {
+        int64_t timestamp = count > 1 ? begin + (end - begin) * static_cast<int64_t>(i) / (count - 1) : begin;
+        while (next < m_size && at(next).timestamp < timestamp) {
+            next++;
+        }
+
+        if (next == 0) {
+            out[i] = at(0);
+        } else if (next == m_size) {
+            out[i] = at(m_size - 1);
+        } else {
+            out[i] = lerp(at(next - 1), at(next), timestamp);
+        }
+        out[i].timestamp = timestamp;
+    }
+}
+
+
+LocalProjection::LocalProjection() : m_anchored(false), m_lat(0), m_lon(0), m_x(0), m_y(0),
+                                     m_dxdlat(0), m_dxdlon(0), m_dydlat(0), m_dydlon(0) {}
+
+bool LocalProjection::needsAnchor(double lat, double lon) const {
+    return !m_anchored || std::fabs(lat - m_lat) > ANCHOR_RANGE || std::fabs(lon - m_lon) > ANCHOR_RANGE;
+}
+
+void LocalProjection::setAnchor(double lat, double lon, double x, double y, double dxdlat, double dxdlon, double dydlat, double dydlon) {
+    m_anchored = true;
+    m_lat = lat;
+    m_lon = lon;
+    m_x = x;
+    m_y = y;
+    m_dxdlat = dxdlat;
+    m_dxdlon = dxdlon;
+    m_dydlat = dydlat;
+    m_dydlon = dydlon;
+}
+
+void LocalProjection::project(double lat, double lon, double &x, double &y) const {
+    double dlat = lat - m_lat;
+    double dlon = lon - m_lon;
+    x = m_x + m_dxdlat * dlat + m_dxdlon * dlon;
+    y = m_y + m_dydlat * dlat + m_dydlon * dlon;
+}
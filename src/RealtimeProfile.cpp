@@ -0,0 +1,95 @@
+#include "RealtimeProfile.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <pthread.h>
+#include <alloca.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "TaskScheduler.h"
+
+
+static bool pinThread(pthread_t thread, int core) {
+    if (core < 0) {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    const int result = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (result != 0) {
+        std::cerr << "Thread could not be pinned to core " << core << ": " << strerror(result) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool setFifo(pthread_t thread, int priority) {
+    if (priority <= 0) {
+        return true;
+    }
+    struct sched_param param;
+    param.sched_priority = priority;
+    const int result = pthread_setschedparam(thread, SCHED_FIFO, &param);
+    if (result != 0) {
+        std::cerr << "SCHED_FIFO " << priority << " could not be set: " << strerror(result) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+std::vector<int> RealtimeProfile::parseCores(const std::string &cores) {
+    std::vector<int> parsed;
+    std::stringstream list(cores);
+    std::string core;
+    while (std::getline(list, core, ',')) {
+        if (!core.empty()) {
+            parsed.push_back(std::stoi(core));
+        }
+    }
+    return parsed;
+}
+
+int RealtimeProfile::coreOfWorker(uint32_t worker) const {
+    if (cores.empty()) {
+        return -1;
+    }
+    if (cores.size() == 1) {
+        return cores[0];
+    }
+    return cores[1 + worker % (cores.size() - 1)];
+}
+
+bool RealtimeProfile::applyToProcess() const {
+    bool applied = true;
+    if (lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cerr << "Memory could not be locked: " << strerror(errno) << std::endl;
+        applied = false;
+    }
+    if (!cores.empty() || priority > 0) {
+        const RealtimeProfile profile = *this;
+        TaskScheduler::instance().setWorkerSetup([profile](uint32_t worker) {
+            pinThread(pthread_self(), profile.coreOfWorker(worker));
+            setFifo(pthread_self(), profile.priority);
+            prefaultStack(256 * 1024);
+        });
+    }
+    return applied;
+}
+
+bool RealtimeProfile::applyToThisThread() const {
+    const bool pinned = pinThread(pthread_self(), cores.empty() ? -1 : cores[0]);
+    const bool scheduled = setFifo(pthread_self(), priority);
+    prefaultStack(256 * 1024);
+    return pinned && scheduled;
+}
+
+void RealtimeProfile::prefaultStack(size_t bytes) {
+    // volatile, so the compiler keeps the writes
+    volatile char *stack = static_cast<volatile char *>(alloca(bytes));
+    for (size_t i = 0; i < bytes; i += 4096) {
+        stack[i] = 0;
+    }
+}
@@ -0,0 +1,57 @@
+#include "RoiMask.h"
+#include <algorithm>
+#include <cmath>
+
+
+RoiMask::RoiMask(double minX, double minY, double maxX, double maxY, float resolution) :
+        m_minX(minX), m_minY(minY), m_resolution(resolution), m_inverse(1.0 / resolution), m_width(0), m_height(0), m_bits() {
+    m_width = std::max<int64_t>(1, static_cast<int64_t>(std::ceil((maxX - minX) * m_inverse)));
+    m_height = std::max<int64_t>(1, static_cast<int64_t>(std::ceil((maxY - minY) * m_inverse)));
+    m_bits.assign((m_width * m_height + 63) / 64, 0);
+}
+
+void RoiMask::set(int64_t cx, int64_t cy) {
+    const uint64_t bit = static_cast<uint64_t>(cy) * m_width + cx;
+    m_bits[bit >> 6] |= uint64_t(1) << (bit & 63);
+}
+
+void RoiMask::addSegment(double x0, double y0, double x1, double y1, double halfWidth) {
+    // bounding box of the capsule in cells
+    const int64_t beginX = std::max<int64_t>(0, static_cast<int64_t>(std::floor((std::min(x0, x1) - halfWidth - m_minX) * m_inverse)));
+    const int64_t beginY = std::max<int64_t>(0, static_cast<int64_t>(std::floor((std::min(y0, y1) - halfWidth - m_minY) * m_inverse)));
+    const int64_t endX = std::min<int64_t>(m_width, static_cast<int64_t>(std::ceil((std::max(x0, x1) + halfWidth - m_minX) * m_inverse)) + 1);
+    const int64_t endY = std::min<int64_t>(m_height, static_cast<int64_t>(std::ceil((std::max(y0, y1) + halfWidth - m_minY) * m_inverse)) + 1);
+
+    const double dx = x1 - x0;
+    const double dy = y1 - y0;
+    const double length2 = dx * dx + dy * dy;
+    for (int64_t cy = beginY; cy < endY; cy++) {
+        for (int64_t cx = beginX; cx < endX; cx++) {
+            // distance from the cell center to the segment
+            const double px = m_minX + (cx + 0.5) * m_resolution - x0;
+            const double py = m_minY + (cy + 0.5) * m_resolution - y0;
+            const double t = length2 > 0 ? std::max(0.0, std::min(1.0, (px * dx + py * dy) / length2)) : 0.0;
+            const double ex = px - t * dx;
+            const double ey = py - t * dy;
+            if (ex * ex + ey * ey <= halfWidth * halfWidth) {
+                set(cx, cy);
+            }
+        }
+    }
+}
+
+uint32_t RoiMask::width() const {
+    return static_cast<uint32_t>(m_width);
+}
+
+uint32_t RoiMask::height() const {
+    return static_cast<uint32_t>(m_height);
+}
+
+uint64_t RoiMask::count() const {
+    uint64_t count = 0;
+    for (auto word : m_bits) {
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
@@ -0,0 +1,69 @@
+#include "ScenarioMask.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "opendlv/data/scenario/Layer.h"
+#include "opendlv/data/scenario/Road.h"
+#include "opendlv/data/scenario/Lane.h"
+#include "opendlv/data/scenario/LaneModel.h"
+#include "opendlv/data/scenario/LaneAttribute.h"
+#include "opendlv/data/scenario/PointModel.h"
+#include "opendlv/data/scenario/StraightLine.h"
+#include "opendlv/data/scenario/IDVertex3.h"
+
+
+using namespace opendlv::data::scenario;
+
+
+struct LaneSegment {
+    double x0, y0, x1, y1;
+    double halfWidth;
+};
+
+std::shared_ptr<RoiMask> rasterizeScenario(const Scenario &scenario, float resolution, double margin) {
+    std::vector<LaneSegment> segments;
+    for (auto &layer : scenario.getListOfLayers()) {
+        for (auto &road : layer.getListOfRoads()) {
+            for (auto &lane : road.getListOfLanes()) {
+                const LaneModel *model = lane.getLaneModel();
+                if (model == nullptr) {
+                    continue;
+                }
+                const double halfWidth = model->getLaneAttribute().getWidth() / 2.0 + margin;
+
+                std::vector<Vertex3> vertices;
+                if (const PointModel *points = dynamic_cast<const PointModel *>(model)) {
+                    for (auto &vertex : points->getListOfIdentifiableVertices()) {
+                        vertices.push_back(vertex);
+                    }
+                } else if (const StraightLine *line = dynamic_cast<const StraightLine *>(model)) {
+                    vertices.push_back(line->getStart());
+                    vertices.push_back(line->getEnd());
+                }
+                for (size_t i = 1; i < vertices.size(); i++) {
+                    LaneSegment segment = {vertices[i - 1].getX(), vertices[i - 1].getY(), vertices[i].getX(), vertices[i].getY(), halfWidth};
+                    segments.push_back(segment);
+                }
+            }
+        }
+    }
+    if (segments.empty()) {
+        return std::shared_ptr<RoiMask>();
+    }
+
+    double minX = std::numeric_limits<double>::max(), minY = minX;
+    double maxX = -minX, maxY = -minX;
+    for (auto &segment : segments) {
+        minX = std::min(minX, std::min(segment.x0, segment.x1) - segment.halfWidth);
+        minY = std::min(minY, std::min(segment.y0, segment.y1) - segment.halfWidth);
+        maxX = std::max(maxX, std::max(segment.x0, segment.x1) + segment.halfWidth);
+        maxY = std::max(maxY, std::max(segment.y0, segment.y1) + segment.halfWidth);
+    }
+
+    std::shared_ptr<RoiMask> mask(new RoiMask(minX, minY, maxX, maxY, resolution));
+    for (auto &segment : segments) {
+        mask->addSegment(segment.x0, segment.y0, segment.x1, segment.y1, segment.halfWidth);
+    }
+    return mask;
+}
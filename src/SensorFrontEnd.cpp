@@ -0,0 +1,446 @@
+#include "SensorFrontEnd.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <new>
+
+#include "Utils.h"
+#include "dbscan.h"
+#include "Logger.h"
+#include "TaskScheduler.h"
+
+
+using namespace std;
+
+// a box needs as many points as the core point of a DbScan cluster
+static const uint32_t PRESEGMENT_MIN_POINTS = 6;
+// columns per task of the scheduler
+static const uint32_t COLUMN_GRAIN = 250;
+// cluster storage of a frame, far more than DbScan needs with heavy clutter
+static const size_t FRAME_ARENA_BYTES = HugePages::PAGE_SIZE;
+
+
+SensorFrontEnd::SensorFrontEnd(const Extrinsics &extrinsics) :
+        m_extrinsics(extrinsics), m_stored_distances(), m_arena(FRAME_ARENA_BYTES), gen(rd()) {}
+
+void *SensorFrontEnd::operator new(size_t bytes) {
+    void *memory = HugePages::map(bytes);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void SensorFrontEnd::operator delete(void *memory, size_t bytes) {
+    HugePages::unmap(memory, bytes);
+}
+
+void SensorFrontEnd::setGroundModel(GroundModel model) {
+    m_groundModel = model;
+}
+
+void SensorFrontEnd::prefault(uint32_t boxes) {
+    for (auto &column : m_points) {
+        for (auto &point : column) {
+            point = Point();
+        }
+    }
+    for (auto &pose : m_column_poses) {
+        pose = Pose();
+    }
+    m_stored_distances.reserve(2000 * 16);
+    m_box_of.reserve(2000 * 16);
+    for (auto *box : {&m_box_x, &m_box_y, &m_box_cos, &m_box_sin, &m_box_length, &m_box_width}) {
+        box->reserve(boxes);
+    }
+    m_box_points.reserve(boxes);
+}
+
+Point (&SensorFrontEnd::points())[2000][16] {
+    return m_points;
+}
+
+unsigned int SensorFrontEnd::cloudSize() const {
+    return m_cloudSize;
+}
+
+bool SensorFrontEnd::owns(const Point *point) const {
+    return point >= &m_points[0][0] && point < &m_points[0][0] + 2000 * 16;
+}
+
+float SensorFrontEnd::originX() const {
+    return m_origin_x;
+}
+
+float SensorFrontEnd::originY() const {
+    return m_origin_y;
+}
+
+void SensorFrontEnd::store(const Sweep &sweep) {
+    m_stored = sweep;
+    m_stored_distances.assign(sweep.distances, sweep.distances + sweep.columns * 16);
+    m_stored.distances = m_stored_distances.data();
+    m_has_stored = true;
+}
+
+bool SensorFrontEnd::hasStored() const {
+    return m_has_stored;
+}
+
+void SensorFrontEnd::decodeStored(const PoseBuffer &poses, const Pose &reference) {
+    if (m_has_stored) {
+        decode(m_stored, poses, reference);
+        m_has_stored = false;
+    } else {
+        m_cloudSize = 0;
+    }
+}
+
+void SensorFrontEnd::segmentGround() {
+    if (m_cloudSize == 0) {
+        return;
+    }
+    if (m_groundModel == GroundModel::Plane) {
+        segmentGroundByPlane();
+    } else {
+        segmentGroundByHeight();
+    }
+}
+
+uint32_t SensorFrontEnd::applyMask(const RoiMask &mask) {
+    uint32_t excluded = 0;
+    for (uint32_t i = 0; i < m_cloudSize; i++) {
+        for (uint32_t offset = 0; offset < 16; offset++) {
+            Point &point = m_points[i][offset];
+            if (!point.isGround() && !mask.contains(m_reference_x + point.getX(), m_reference_y + point.getY())) {
+                point.setOutsideRoi(true);
+                point.setVisited(true);
+                point.setClustered(true);
+                excluded++;
+            }
+        }
+    }
+    return excluded;
+}
+
+uint32_t SensorFrontEnd::applyStaticMap(const StaticMap &map) {
+    uint32_t excluded = 0;
+    for (uint32_t i = 0; i < m_cloudSize; i++) {
+        for (uint32_t offset = 0; offset < 16; offset++) {
+            Point &point = m_points[i][offset];
+            if (!point.isGround() && !point.isOutsideRoi() && map.isStatic(m_reference_x + point.getX(), m_reference_y + point.getY())) {
+                point.setStatic(true);
+                point.setVisited(true);
+                point.setClustered(true);
+                excluded++;
+            }
+        }
+    }
+    return excluded;
+}
+
+void SensorFrontEnd::observeStructure(StaticMap &map) {
+    for (uint32_t i = 0; i < m_cloudSize; i++) {
+        for (uint32_t offset = 0; offset < 16; offset++) {
+            Point &point = m_points[i][offset];
+            if (!point.isGround() && point.getZ() > StaticMap::STRUCTURE_HEIGHT) {
+                map.observe(m_reference_x + point.getX(), m_reference_y + point.getY());
+            }
+        }
+    }
+}
+
+uint32_t SensorFrontEnd::presegment(const std::vector<TrackBox> &boxes, std::vector<Cluster> &clusters) {
+    const uint32_t count = boxes.size();
+    // the clusters of the last frame are not read any more
+    m_arena.reset();
+    clusters.clear();
+    clusters.resize(count, Cluster(ArenaAllocator<Point *>(&m_arena)));
+    if (count == 0) {
+        return 0;
+    }
+
+    m_box_x.resize(count);
+    m_box_y.resize(count);
+    m_box_cos.resize(count);
+    m_box_sin.resize(count);
+    m_box_length.resize(count);
+    m_box_width.resize(count);
+    for (uint32_t b = 0; b < count; b++) {
+        m_box_x[b] = boxes[b].x;
+        m_box_y[b] = boxes[b].y;
+        m_box_cos[b] = boxes[b].cos;
+        m_box_sin[b] = boxes[b].sin;
+        m_box_length[b] = boxes[b].halfLength;
+        m_box_width[b] = boxes[b].halfWidth;
+    }
+    const float *boxX = m_box_x.data();
+    const float *boxY = m_box_y.data();
+    const float *boxCos = m_box_cos.data();
+    const float *boxSin = m_box_sin.data();
+    const float *boxLength = m_box_length.data();
+    const float *boxWidth = m_box_width.data();
+
+    m_box_of.resize(m_cloudSize * 16);
+    m_box_points.assign(count, 0);
+    Point *points = &m_points[0][0];
+    for (uint32_t i = 0; i < m_cloudSize * 16; i++) {
+        Point &point = points[i];
+        uint32_t hit = count;
+        if (!point.isGround() && !point.isOutsideRoi() && !point.isStatic()) {
+            const float x = point.getX();
+            const float y = point.getY();
+            // branchless over all boxes, the compiler vectorizes this loop
+            for (uint32_t b = 0; b < count; b++) {
+                const float dx = x - boxX[b];
+                const float dy = y - boxY[b];
+                const bool inside = (std::fabs(dx * boxCos[b] + dy * boxSin[b]) <= boxLength[b]) &
+                                    (std::fabs(dy * boxCos[b] - dx * boxSin[b]) <= boxWidth[b]);
+                hit = std::min(hit, inside ? b : count);
+            }
+            if (hit < count) {
+                m_box_points[hit]++;
+            }
+        }
+        m_box_of[i] = hit;
+    }
+
+    uint32_t assigned = 0;
+    for (uint32_t i = 0; i < m_cloudSize * 16; i++) {
+        const uint32_t b = m_box_of[i];
+        if (b < count && m_box_points[b] >= PRESEGMENT_MIN_POINTS) {
+            points[i].setTracked(true);
+            points[i].setVisited(true);
+            points[i].setClustered(true);
+            clusters[b].m_cluster.push_back(&points[i]);
+            assigned++;
+        }
+    }
+    return assigned;
+}
+
+void SensorFrontEnd::cluster(std::vector<Cluster> &clusters, int stride, int window) {
+    DbScan dbScan = DbScan(m_points, m_cloudSize);
+    dbScan.setArena(&m_arena);
+    dbScan.setColumnStride(stride);
+    dbScan.setWindow(window);
+    dbScan.getClusters(clusters);
+}
+
+std::list<Point *> SensorFrontEnd::getAllPointsNextToSlow(Eigen::Vector2d x, double delta) {
+    std::list<Point *> points;
+    for (uint32_t i = 0; i < m_cloudSize; i++) {
+        for (uint32_t offset = 0; offset < 16; offset++) {
+            if (m_points[i][offset].get2Distance(x[0], x[1]) < delta && !m_points[i][offset].isGround()) {
+                points.push_back(&m_points[i][offset]);
+            }
+        }
+    }
+    return points;
+}
+
+void SensorFrontEnd::decode(const Sweep &sweep, const PoseBuffer &poses, const Pose &reference) {
+    static const int maping[] = {-15, -13, -11, -9, -7, -5, -3, -1, 1, 3, 5, 7, 9, 11, 13, 15};
+    //static const int maping[] = {-15, -14,-13,-12, -11,-10, -9, -9,-7,-6, -5,-4, -3,-2, -1,0};//, 1,2, 3,4, 5,6, 7,8, 9,10, 11,12, 13,14, 15};
+    m_cloudSize = std::min<uint32_t>(sweep.columns, 2000);
+
+    if (m_last_timestamp != 0) {
+        m_sweep_duration = std::min<int64_t>(std::max<int64_t>(sweep.timestamp - m_last_timestamp, 0), 200000);
+    }
+    m_last_timestamp = sweep.timestamp;
+
+    m_reference_x = reference.x;
+    m_reference_y = reference.y;
+    m_origin_x = static_cast<float>(m_extrinsics.x * sin(utils::deg2rad(reference.heading)) - m_extrinsics.y * cos(utils::deg2rad(reference.heading)));
+    m_origin_y = static_cast<float>(m_extrinsics.x * cos(utils::deg2rad(reference.heading)) + m_extrinsics.y * sin(utils::deg2rad(reference.heading)));
+
+    m_startAzimuth = utils::deg2rad(sweep.startAzimuth + m_extrinsics.yaw + reference.heading);
+    m_endAzimuth = utils::deg2rad(sweep.endAzimuth + m_extrinsics.yaw + reference.heading);
+
+    vector<double> azimuth_range = utils::linspace(m_startAzimuth, m_endAzimuth, m_cloudSize);
+
+    // The sweep timestamp is taken as the time of the last column.
+    const int64_t sweepEnd = sweep.timestamp;
+    poses.interpolate(sweepEnd - m_sweep_duration, sweepEnd, m_cloudSize, m_column_poses);
+
+
+    const uint16_t *data = sweep.distances;
+
+    TaskScheduler::instance().parallelFor(m_cloudSize, COLUMN_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin * 16; i < end * 16; i += 16) {
+            const Pose &columnPose = m_column_poses[i / 16];
+            const double heading = poses.empty() ? reference.heading : columnPose.heading;
+            const float azimuth = static_cast<float>(azimuth_range[i / 16] + utils::deg2rad(heading - reference.heading));
+            const float sinAzimuth = sin(azimuth);
+            const float cosAzimuth = cos(azimuth);
+            // mounting position of the lidar, rotated with the vehicle
+            const double sinHeading = sin(utils::deg2rad(heading));
+            const double cosHeading = cos(utils::deg2rad(heading));
+            float dx = static_cast<float>(m_extrinsics.x * sinHeading - m_extrinsics.y * cosHeading);
+            float dy = static_cast<float>(m_extrinsics.x * cosHeading + m_extrinsics.y * sinHeading);
+            if (!poses.empty()) {
+                dx += static_cast<float>(columnPose.x - reference.x);
+                dy += static_cast<float>(columnPose.y - reference.y);
+            }
+            for (uint32_t offset = 0; offset < 16; offset++) {
+                float measurement = static_cast<float>(data[i + offset]) / 100.0;
+                float xy_range = measurement * cos(static_cast<float>(utils::deg2rad(maping[offset])));
+                float x = xy_range * sinAzimuth + dx;
+                float y = xy_range * cosAzimuth + dy;
+                float z = measurement * sin(static_cast<float>(utils::deg2rad(maping[offset]))) + static_cast<float>(m_extrinsics.z);
+                m_points[i / 16][offset] = Point(x, y, z, measurement, azimuth);
+                m_points[i / 16][offset].setIndex(i / 16, offset);
+                if (measurement <= 2.5) {
+                    m_points[i / 16][offset].setIsGround(true);
+                    m_points[i / 16][offset].setClustered(true);
+                    m_points[i / 16][offset].setVisited(true);
+                }
+
+            }
+        }
+    });
+
+}
+
+void SensorFrontEnd::segmentGroundByPlane() {
+    // devide measurement in sections
+    unsigned int sector_size = m_cloudSize / 30;
+    std::vector<Point *> minis;
+//    for (int sec = 0; sec < 12; sec += 1) {
+//        std::vector<Point *> tmp = utils::minZinSec(sector_size * sec, sector_size * (sec + 1), m_points);
+//        minis.insert(minis.end(), tmp.begin(), tmp.end());
+//    }
+
+
+    std::vector<Point *> tmp = utils::minZinSec(sector_size * 0 + sector_size / 2, sector_size * (0 + 1) + sector_size / 2, m_points);
+    minis.insert(minis.end(), tmp.begin(), tmp.end());
+    tmp = utils::minZinSec(sector_size * 12 + sector_size / 2, sector_size * (12 + 1) + sector_size / 2, m_points);
+    minis.insert(minis.end(), tmp.begin(), tmp.end());
+    tmp = utils::minZinSec(sector_size * 14 + sector_size / 2, sector_size * (14 + 1) + sector_size / 2, m_points);
+    minis.insert(minis.end(), tmp.begin(), tmp.end());
+    tmp = utils::minZinSec(sector_size * 28 + sector_size / 2, sector_size * (28 + 1) + sector_size / 2, m_points);
+    minis.insert(minis.end(), tmp.begin(), tmp.end());
+
+    // RANSAC
+    double besterror = 100000000;
+
+    std::uniform_int_distribution<> dis(0, ((minis.size() - 1)));
+
+    for (int probes = 0; probes < 50; probes++) {
+        std::vector<Point *> maybeinliers;
+        std::vector<Point *> alsoinliers;
+        // select 3 random points
+        maybeinliers.push_back(minis[dis(gen)]);
+        maybeinliers.push_back(minis[dis(gen)]);
+        maybeinliers.push_back(minis[dis(gen)]);
+
+        // Triange fitting
+//        int offset = dis(gen);
+//        maybeinliers.push_back(minis[offset]);
+//        maybeinliers.push_back(minis[offset + ((minis.size() - 1) / 3)]);
+//        maybeinliers.push_back(minis[offset + 2 * ((minis.size() - 1) / 3)]);
+
+
+        Plane maybemodel(maybeinliers);
+
+        for (auto &point : minis) {
+            if (std::find(maybeinliers.begin(), maybeinliers.end(), point) == maybeinliers.end()) {
+                float distance = std::abs(maybemodel.getDist(point->getVec()));
+                if (distance < 0.2) {
+                    alsoinliers.push_back(point);
+                }
+            }
+        }
+        if (alsoinliers.size() > 10) {
+            // this implies that we may have found a good model
+            // now test how good it is
+            Plane plane;
+            double err = plane.fitPlaneFromPoints(alsoinliers);
+            if (err < besterror && plane.distance > 1.9 && plane.distance < 2.1) {
+                besterror = err;
+                m_bestGroundModel = plane;
+            }
+        }
+    }
+    logMessage(LogLevel::Debug, "BestErr:", besterror);
+    logMessage(LogLevel::Debug, "Groundplane Distance:", m_bestGroundModel.distance);
+    logMessage(LogLevel::Debug, "Groundplane Vector:", m_bestGroundModel.normal[0], m_bestGroundModel.normal[1], m_bestGroundModel.normal[2]);
+
+    TaskScheduler::instance().parallelFor(m_cloudSize, COLUMN_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i += 1) {
+            for (uint32_t offset = 0; offset < 16; offset++) {
+                //Eigen::Vector3f point = m_points[i][offset].getVec();
+                if (m_bestGroundModel.getDist(m_points[i][offset].getVec()) > -0.3) {
+                    m_points[i][offset].setVisited(true);
+                    m_points[i][offset].setClustered(true);
+                    m_points[i][offset].setIsGround(true);
+                }
+            }
+            findNearestReturn(i);
+        }
+    });
+
+}
+
+void SensorFrontEnd::segmentGroundByHeight() {
+    TaskScheduler::instance().parallelFor(m_cloudSize, COLUMN_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i += 1) {
+            for (uint32_t offset = 0; offset < 16; offset++) {
+                //Eigen::Vector3f point = m_points[i][offset].getVec();
+                if (m_points[i][offset].getZ() < -1.6) {
+                    //cout<<"Delete"<<endl;
+                    m_points[i][offset].setVisited(true);
+                    m_points[i][offset].setClustered(true);
+                    m_points[i][offset].setIsGround(true);
+                }
+            }
+            findNearestReturn(i);
+        }
+    });
+
+}
+
+void SensorFrontEnd::findNearestReturn(uint32_t column) {
+    float ranges[16];
+    for (uint32_t offset = 0; offset < 16; offset++) {
+        Point &point = m_points[column][offset];
+        const Eigen::Vector3f &position = point.getVec();
+        ranges[offset] = point.isGround() ? std::numeric_limits<float>::infinity() :
+                         position[0] * position[0] + position[1] * position[1];
+    }
+    // pairwise minimum over the rings instead of one long dependency chain, the compiler
+    // vectorizes every step
+    float lanes[8];
+    for (uint32_t k = 0; k < 8; k++) {
+        lanes[k] = std::min(ranges[k], ranges[k + 8]);
+    }
+    for (uint32_t width = 4; width > 0; width /= 2) {
+        for (uint32_t k = 0; k < width; k++) {
+            lanes[k] = std::min(lanes[k], lanes[k + width]);
+        }
+    }
+    uint8_t ring = 16;
+    if (lanes[0] < std::numeric_limits<float>::infinity()) {
+        ring = static_cast<uint8_t>(std::find(ranges, ranges + 16, lanes[0]) - ranges);
+    }
+    m_nearest_range[column] = lanes[0];
+    m_nearest_ring[column] = ring;
+}
+
+void SensorFrontEnd::addFreeSpace(FreeSpaceSection &freeSpace) const {
+    for (uint32_t i = 0; i < m_cloudSize; i++) {
+        if (m_nearest_ring[i] >= 16) {
+            continue;
+        }
+        const Point &point = m_points[i][m_nearest_ring[i]];
+        // clockwise from the y axis like the azimuth of decode()
+        float bearing = std::atan2(point.getX(), point.getY()) * static_cast<float>(180.0 / M_PI);
+        if (bearing < 0) {
+            bearing += 360;
+        }
+        const uint32_t bin = std::min<uint32_t>(static_cast<uint32_t>(bearing * FREE_SPACE_BINS / 360), FREE_SPACE_BINS - 1);
+        const float centimeters = std::sqrt(m_nearest_range[i]) * 100;
+        const uint16_t range = static_cast<uint16_t>(std::min<float>(centimeters, FREE_SPACE_NO_RETURN - 1));
+        freeSpace.range[bin] = std::min(freeSpace.range[bin], range);
+    }
+}
@@ -0,0 +1,135 @@
+#include "SharedMemoryChannel.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+SharedMemoryPublisher::SharedMemoryPublisher(const std::string &name, uint32_t obstacleCapacity, uint32_t labelCapacity) :
+        m_name(name), m_region(nullptr), m_size(0) {
+    // keep the label array aligned
+    obstacleCapacity = (obstacleCapacity + 7u) & ~7u;
+    m_size = sizeof(SharedFrameHeader) + obstacleCapacity + labelCapacity * sizeof(uint16_t);
+
+    // a fresh object instead of resizing the one of an earlier run under its readers
+    shm_unlink(m_name.c_str());
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "Shared memory " << m_name << " could not be opened: " << strerror(errno) << std::endl;
+        return;
+    }
+    if (ftruncate(fd, m_size) != 0) {
+        std::cerr << "Shared memory " << m_name << " could not be resized: " << strerror(errno) << std::endl;
+        close(fd);
+        return;
+    }
+    void *region = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        std::cerr << "Shared memory " << m_name << " could not be mapped: " << strerror(errno) << std::endl;
+        return;
+    }
+    m_region = region;
+
+    SharedFrameHeader *header = reinterpret_cast<SharedFrameHeader *>(m_region);
+    header->sequence.store(header->sequence.load(std::memory_order_relaxed) | 1u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHARED_FRAME_MAGIC;
+    header->version = SHARED_FRAME_VERSION;
+    header->reserved = 0;
+    header->obstacleCapacity = obstacleCapacity;
+    header->labelCapacity = labelCapacity;
+    header->obstacleBytes = 0;
+    header->columns = 0;
+    header->layers = 0;
+    header->padding = 0;
+    header->sequence.fetch_add(1, std::memory_order_release);
+}
+
+SharedMemoryPublisher::~SharedMemoryPublisher() {
+    if (m_region != nullptr) {
+        // attached readers see that the region is gone
+        SharedFrameHeader *header = reinterpret_cast<SharedFrameHeader *>(m_region);
+        header->sequence.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = 0;
+        header->sequence.fetch_add(1, std::memory_order_release);
+        munmap(m_region, m_size);
+        shm_unlink(m_name.c_str());
+    }
+}
+
+bool SharedMemoryPublisher::isOpen() const {
+    return m_region != nullptr;
+}
+
+void SharedMemoryPublisher::publish(const std::string &frame, const uint16_t *labels, uint32_t columns, uint32_t layers) {
+    if (m_region == nullptr) {
+        return;
+    }
+    SharedFrameHeader *header = reinterpret_cast<SharedFrameHeader *>(m_region);
+    char *obstacles = reinterpret_cast<char *>(header + 1);
+    uint16_t *labelArea = reinterpret_cast<uint16_t *>(obstacles + header->obstacleCapacity);
+
+    // odd sequence: readers retry until we are done
+    header->sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (frame.size() <= header->obstacleCapacity) {
+        memcpy(obstacles, frame.data(), frame.size());
+        header->obstacleBytes = frame.size();
+    } else {
+        header->obstacleBytes = 0;
+    }
+
+    if (labels != nullptr && columns * layers <= header->labelCapacity) {
+        memcpy(labelArea, labels, columns * layers * sizeof(uint16_t));
+        header->columns = columns;
+        header->layers = layers;
+    } else {
+        header->columns = 0;
+        header->layers = 0;
+    }
+
+    header->sequence.fetch_add(1, std::memory_order_release);
+}
+
+
+SharedMemoryReader::SharedMemoryReader(const std::string &name) : m_region(nullptr), m_size(0) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SharedFrameHeader)) {
+        close(fd);
+        return;
+    }
+    void *region = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        return;
+    }
+    m_size = info.st_size;
+    const SharedFrameHeader *header = reinterpret_cast<const SharedFrameHeader *>(region);
+    if (header->magic != SHARED_FRAME_MAGIC || header->version != SHARED_FRAME_VERSION ||
+        !fits(header->obstacleCapacity, header->labelCapacity)) {
+        munmap(region, m_size);
+        m_size = 0;
+        return;
+    }
+    m_region = region;
+}
+
+SharedMemoryReader::~SharedMemoryReader() {
+    if (m_region != nullptr) {
+        munmap(m_region, m_size);
+    }
+}
+
+bool SharedMemoryReader::isOpen() const {
+    return m_region != nullptr && reinterpret_cast<const SharedFrameHeader *>(m_region)->magic == SHARED_FRAME_MAGIC;
+}
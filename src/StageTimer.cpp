@@ -0,0 +1,355 @@
+#include "StageTimer.h"
+#include <cmath>
+#include "Logger.h"
+
+
+const char *stageName(Stage stage) {
+    static const char *names[] = {"decode", "ground", "presegment", "cluster", "associate", "filter", "shape", "grid", "serialize", "send"};
+    return names[static_cast<uint32_t>(stage)];
+}
+
+
+LatencyHistogram::LatencyHistogram() : m_count(0), m_max(0) {
+    for (uint32_t i = 0; i < BUCKETS; i++) {
+        m_counts[i] = 0;
+    }
+}
+
+uint32_t LatencyHistogram::bucketOf(uint64_t value) {
+    if (value < 2 * SUB_BUCKETS) {
+        return static_cast<uint32_t>(value);
+    }
+    uint32_t exponent = 63 - __builtin_clzll(value);
+    // top five bits: 16..31
+    uint32_t mantissa = static_cast<uint32_t>(value >> (exponent - 4));
+    uint32_t bucket = (exponent - 3) * SUB_BUCKETS + mantissa - SUB_BUCKETS;
+    return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::upperBoundOf(uint32_t bucket) {
+    if (bucket < 2 * SUB_BUCKETS) {
+        return bucket;
+    }
+    uint32_t exponent = bucket / SUB_BUCKETS + 3;
+    uint64_t mantissa = SUB_BUCKETS + bucket % SUB_BUCKETS;
+    return ((mantissa + 1) << (exponent - 4)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    m_counts[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(fraction * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKETS; i++) {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t bound = upperBoundOf(i);
+            return bound < max() ? bound : max();
+        }
+    }
+    return max();
+}
+
+uint64_t LatencyHistogram::max() const {
+    return m_max.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+    return m_count.load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset() {
+    for (uint32_t i = 0; i < BUCKETS; i++) {
+        m_counts[i].store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+
+StageTimers &StageTimers::instance() {
+    static StageTimers timers;
+    return timers;
+}
+
+StageTimers::StageTimers() : m_frameAllocations(0), m_frameAllocatedBytes(0), m_countingAllocations(false), m_countingEvents(false) {
+    for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+        m_current[i] = 0;
+        m_ran[i] = false;
+        for (uint32_t e = 0; e < PERF_EVENT_COUNT; e++) {
+            m_events[i][e] = 0;
+            m_frameEvents[i][e] = 0;
+            m_totalEvents[i][e] = 0;
+        }
+    }
+    for (uint32_t e = 0; e < PERF_EVENT_COUNT; e++) {
+        m_eventAvailable[e] = false;
+    }
+    for (uint32_t i = 0; i <= STAGE_COUNT; i++) {
+        m_allocations[i] = 0;
+        m_allocatedBytes[i] = 0;
+    }
+}
+
+void StageTimers::add(Stage stage, uint64_t nanoseconds) {
+    uint32_t i = static_cast<uint32_t>(stage);
+    m_current[i].fetch_add(nanoseconds, std::memory_order_relaxed);
+    m_ran[i].store(true, std::memory_order_relaxed);
+}
+
+void StageTimers::addAllocation(Stage stage, uint64_t bytes) {
+    uint32_t i = static_cast<uint32_t>(stage);
+    m_allocations[i].fetch_add(1, std::memory_order_relaxed);
+    m_allocatedBytes[i].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void StageTimers::setCountingAllocations(bool counting) {
+    m_countingAllocations = counting;
+}
+
+bool StageTimers::countsAllocations() const {
+    return m_countingAllocations;
+}
+
+void StageTimers::addEvents(Stage stage, const uint64_t *counts) {
+    uint32_t i = static_cast<uint32_t>(stage);
+    for (uint32_t e = 0; e < PERF_EVENT_COUNT; e++) {
+        m_events[i][e].fetch_add(counts[e], std::memory_order_relaxed);
+    }
+}
+
+bool StageTimers::setCountingEvents(bool counting) {
+    if (!counting) {
+        // keeps the events of the last run for its totals
+        m_countingEvents = false;
+        return false;
+    }
+    const PerfCounters &counters = PerfCounters::thisThread();
+    m_countingEvents = counters.available();
+    // the same CPU runs all threads, so they have the same events
+    for (uint32_t e = 0; e < PERF_EVENT_COUNT; e++) {
+        m_eventAvailable[e] = counters.available(static_cast<PerfEvent>(e));
+    }
+    return m_countingEvents;
+}
+
+bool StageTimers::countsEvents() const {
+    return m_countingEvents.load(std::memory_order_relaxed);
+}
+
+bool StageTimers::countsEvent(PerfEvent event) const {
+    return m_eventAvailable[static_cast<uint32_t>(event)];
+}
+
+void StageTimers::beginFrame() {
+    for (uint32_t i = 0; i <= STAGE_COUNT; i++) {
+        m_allocations[i].store(0, std::memory_order_relaxed);
+        m_allocatedBytes[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void StageTimers::endFrame(uint64_t frameNanoseconds) {
+    for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+        if (m_ran[i].exchange(false, std::memory_order_relaxed)) {
+            m_histograms[i].record(m_current[i].exchange(0, std::memory_order_relaxed));
+        }
+    }
+    m_frames.record(frameNanoseconds);
+
+    if (m_countingEvents) {
+        for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+            for (uint32_t e = 0; e < PERF_EVENT_COUNT; e++) {
+                m_frameEvents[i][e] = m_events[i][e].exchange(0, std::memory_order_relaxed);
+                m_totalEvents[i][e] += m_frameEvents[i][e];
+            }
+            const uint64_t cycles = m_frameEvents[i][static_cast<uint32_t>(PerfEvent::Cycles)];
+            if (cycles > 0) {
+                m_ipcHistograms[i].record(m_frameEvents[i][static_cast<uint32_t>(PerfEvent::Instructions)] * 1000 / cycles);
+            }
+        }
+    }
+
+    if (m_countingAllocations) {
+        m_frameAllocations = 0;
+        m_frameAllocatedBytes = 0;
+        for (uint32_t i = 0; i <= STAGE_COUNT; i++) {
+            const uint64_t allocations = m_allocations[i].exchange(0, std::memory_order_relaxed);
+            m_allocationHistograms[i].record(allocations);
+            m_frameAllocations += allocations;
+            m_frameAllocatedBytes += m_allocatedBytes[i].exchange(0, std::memory_order_relaxed);
+        }
+        m_frameAllocationHistogram.record(m_frameAllocations);
+    }
+}
+
+const LatencyHistogram &StageTimers::histogram(Stage stage) const {
+    return m_histograms[static_cast<uint32_t>(stage)];
+}
+
+const LatencyHistogram &StageTimers::frameHistogram() const {
+    return m_frames;
+}
+
+const LatencyHistogram &StageTimers::allocationHistogram(Stage stage) const {
+    return m_allocationHistograms[static_cast<uint32_t>(stage)];
+}
+
+const LatencyHistogram &StageTimers::frameAllocationHistogram() const {
+    return m_frameAllocationHistogram;
+}
+
+uint64_t StageTimers::frameAllocations() const {
+    return m_frameAllocations;
+}
+
+uint64_t StageTimers::frameAllocatedBytes() const {
+    return m_frameAllocatedBytes;
+}
+
+uint64_t StageTimers::frameEvents(Stage stage, PerfEvent event) const {
+    return m_frameEvents[static_cast<uint32_t>(stage)][static_cast<uint32_t>(event)];
+}
+
+uint64_t StageTimers::totalEvents(Stage stage, PerfEvent event) const {
+    return m_totalEvents[static_cast<uint32_t>(stage)][static_cast<uint32_t>(event)];
+}
+
+const LatencyHistogram &StageTimers::ipcHistogram(Stage stage) const {
+    return m_ipcHistograms[static_cast<uint32_t>(stage)];
+}
+
+void StageTimers::report() {
+    logMessage(LogLevel::Info, "stage latency [us] p50 p99 max frames");
+    for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+        const LatencyHistogram &h = m_histograms[i];
+        if (h.count() > 0) {
+            logMessage(LogLevel::Info, stageName(static_cast<Stage>(i)), h.percentile(0.5) / 1000.0, h.percentile(0.99) / 1000.0,
+                       h.max() / 1000.0, h.count());
+        }
+    }
+    logMessage(LogLevel::Info, "frame", m_frames.percentile(0.5) / 1000.0, m_frames.percentile(0.99) / 1000.0,
+               m_frames.max() / 1000.0, m_frames.count());
+
+    if (m_countingEvents) {
+        // the logger takes four values per line
+        logMessage(LogLevel::Info, "stage instructions per cycle, per frame p1 p50");
+        for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+            const double cycles = m_totalEvents[i][static_cast<uint32_t>(PerfEvent::Cycles)];
+            if (cycles > 0) {
+                const LatencyHistogram &h = m_ipcHistograms[i];
+                logMessage(LogLevel::Info, stageName(static_cast<Stage>(i)), m_totalEvents[i][static_cast<uint32_t>(PerfEvent::Instructions)] / cycles,
+                           h.percentile(0.01) / 1000.0, h.percentile(0.5) / 1000.0);
+            }
+        }
+        logMessage(LogLevel::Info, "stage misses per 1000 instructions L1d LLC branch dTLB");
+        for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+            const double instructions = m_totalEvents[i][static_cast<uint32_t>(PerfEvent::Instructions)];
+            // NaN for the events that are not counted, the logger writes n/a
+            auto perKilo = [&](PerfEvent event) {
+                return countsEvent(event) ? m_totalEvents[i][static_cast<uint32_t>(event)] * 1000 / instructions : NAN;
+            };
+            if (instructions > 0) {
+                logMessage(LogLevel::Info, stageName(static_cast<Stage>(i)), perKilo(PerfEvent::L1Misses), perKilo(PerfEvent::LlcMisses),
+                           perKilo(PerfEvent::BranchMisses), perKilo(PerfEvent::DtlbMisses));
+            }
+        }
+    }
+
+    if (m_countingAllocations) {
+        logMessage(LogLevel::Info, "allocations per frame p50 p99 max");
+        for (uint32_t i = 0; i <= STAGE_COUNT; i++) {
+            const LatencyHistogram &h = m_allocationHistograms[i];
+            if (h.max() > 0) {
+                logMessage(LogLevel::Info, i < STAGE_COUNT ? stageName(static_cast<Stage>(i)) : "other", h.percentile(0.5),
+                           h.percentile(0.99), h.max());
+            }
+        }
+        logMessage(LogLevel::Info, "frame", m_frameAllocationHistogram.percentile(0.5), m_frameAllocationHistogram.percentile(0.99),
+                   m_frameAllocationHistogram.max());
+    }
+    reset();
+}
+
+void StageTimers::reset() {
+    for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+        m_histograms[i].reset();
+    }
+    m_frames.reset();
+    for (uint32_t i = 0; i <= STAGE_COUNT; i++) {
+        m_allocationHistograms[i].reset();
+    }
+    m_frameAllocationHistogram.reset();
+    for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+        m_ipcHistograms[i].reset();
+        for (uint32_t e = 0; e < PERF_EVENT_COUNT; e++) {
+            m_totalEvents[i][e] = 0;
+        }
+    }
+}
+
+
+static thread_local ScopedStageTimer *activeTimer = nullptr;
+
+ScopedStageTimer::ScopedStageTimer(Stage stage) :
+        m_stage(stage), m_elapsed(0), m_parent(activeTimer),
+        m_countingEvents(StageTimers::instance().countsEvents() && PerfCounters::thisThread().available()) {
+    if (m_countingEvents) {
+        for (uint32_t e = 0; e < PERF_EVENT_COUNT; e++) {
+            m_events[e] = 0;
+        }
+    }
+    if (m_parent != nullptr) {
+        m_parent->pause();
+    }
+    activeTimer = this;
+    resume();
+}
+
+Stage ScopedStageTimer::activeStage() {
+    return activeTimer != nullptr ? activeTimer->m_stage : Stage::COUNT;
+}
+
+ScopedStageTimer::~ScopedStageTimer() {
+    pause();
+    StageTimers::instance().add(m_stage, m_elapsed);
+    if (m_countingEvents) {
+        StageTimers::instance().addEvents(m_stage, m_events);
+    }
+    activeTimer = m_parent;
+    if (m_parent != nullptr) {
+        m_parent->resume();
+    }
+}
+
+void ScopedStageTimer::pause() {
+    m_elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+    if (m_countingEvents) {
+        PerfSample end;
+        PerfCounters::thisThread().read(end);
+        uint64_t counts[PERF_EVENT_COUNT];
+        PerfCounters::delta(m_eventStart, end, counts);
+        for (uint32_t e = 0; e < PERF_EVENT_COUNT; e++) {
+            m_events[e] += counts[e];
+        }
+    }
+}
+
+void ScopedStageTimer::resume() {
+    if (m_countingEvents) {
+        PerfCounters::thisThread().read(m_eventStart);
+    }
+    m_start = std::chrono::steady_clock::now();
+}
@@ -0,0 +1,198 @@
+#include "StaticMap.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+const uint32_t StaticMap::TILE_CELLS;
+const uint32_t StaticMap::WINDOW_TILES;
+const uint8_t StaticMap::STATIC_EVIDENCE;
+constexpr float StaticMap::STRUCTURE_HEIGHT;
+const int64_t StaticMap::WINDOW_CELLS;
+
+static const size_t TILE_BYTES = StaticMap::TILE_CELLS * StaticMap::TILE_CELLS;
+static const size_t PAGE_BYTES = 4096;
+
+static int64_t floorDiv(int64_t value, int64_t divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+static size_t tilesOffset(uint32_t tileCount) {
+    const size_t keys = sizeof(StaticMapHeader) + tileCount * sizeof(StaticMapTile);
+    return (keys + PAGE_BYTES - 1) / PAGE_BYTES * PAGE_BYTES;
+}
+
+
+StaticMap::StaticMap(float resolution) :
+        m_resolution(resolution), m_inverse(1.0 / resolution), m_tiles(), m_owned(), m_region(nullptr), m_size(0),
+        m_windowX(0), m_windowY(0), m_observed() {
+    std::fill(m_window, m_window + WINDOW_TILES * WINDOW_TILES, nullptr);
+}
+
+StaticMap::~StaticMap() {
+    unmap();
+}
+
+void StaticMap::unmap() {
+    if (m_region != nullptr) {
+        munmap(m_region, m_size);
+        m_region = nullptr;
+        m_size = 0;
+    }
+}
+
+int64_t StaticMap::key(int32_t x, int32_t y) {
+    return (static_cast<int64_t>(x) << 32) | static_cast<uint32_t>(y);
+}
+
+float StaticMap::resolution() const {
+    return m_resolution;
+}
+
+size_t StaticMap::tileCount() const {
+    return m_tiles.size();
+}
+
+bool StaticMap::load(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(StaticMapHeader)) {
+        close(fd);
+        return false;
+    }
+    // private and writable: the map learns in memory, the file only changes on save()
+    void *region = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        std::cerr << "Static map " << path << " could not be mapped: " << strerror(errno) << std::endl;
+        return false;
+    }
+    const StaticMapHeader *header = reinterpret_cast<const StaticMapHeader *>(region);
+    if (header->magic != STATIC_MAP_MAGIC || header->version != STATIC_MAP_VERSION || header->tileCells != TILE_CELLS ||
+        header->resolution <= 0 ||
+        tilesOffset(header->tileCount) + static_cast<size_t>(header->tileCount) * TILE_BYTES > static_cast<size_t>(info.st_size)) {
+        std::cerr << "Static map " << path << " is not valid" << std::endl;
+        munmap(region, info.st_size);
+        return false;
+    }
+
+    unmap();
+    m_tiles.clear();
+    m_owned.clear();
+    m_observed.clear();
+    m_region = region;
+    m_size = info.st_size;
+    m_resolution = header->resolution;
+    m_inverse = 1.0 / m_resolution;
+
+    const StaticMapTile *keys = reinterpret_cast<const StaticMapTile *>(header + 1);
+    uint8_t *cells = reinterpret_cast<uint8_t *>(region) + tilesOffset(header->tileCount);
+    for (uint32_t i = 0; i < header->tileCount; i++) {
+        m_tiles[key(keys[i].x, keys[i].y)] = cells + i * TILE_BYTES;
+    }
+    updateWindow();
+    return true;
+}
+
+bool StaticMap::save(const std::string &path) const {
+    std::vector<std::pair<int64_t, const uint8_t *>> tiles(m_tiles.begin(), m_tiles.end());
+    std::sort(tiles.begin(), tiles.end());
+
+    StaticMapHeader header;
+    header.magic = STATIC_MAP_MAGIC;
+    header.version = STATIC_MAP_VERSION;
+    header.tileCells = TILE_CELLS;
+    header.resolution = m_resolution;
+    header.tileCount = tiles.size();
+
+    const std::string temporary = path + ".tmp";
+    std::ofstream file(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (auto &tile : tiles) {
+        StaticMapTile entry;
+        entry.x = static_cast<int32_t>(tile.first >> 32);
+        entry.y = static_cast<int32_t>(tile.first & 0xffffffff);
+        file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    }
+    const std::vector<char> padding(tilesOffset(header.tileCount) - sizeof(header) - tiles.size() * sizeof(StaticMapTile), 0);
+    file.write(padding.data(), padding.size());
+    for (auto &tile : tiles) {
+        file.write(reinterpret_cast<const char *>(tile.second), TILE_BYTES);
+    }
+    file.close();
+    if (!file.good() || rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cerr << "Static map " << path << " could not be written" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+uint8_t *StaticMap::tile(int32_t x, int32_t y, bool create) {
+    auto found = m_tiles.find(key(x, y));
+    if (found != m_tiles.end()) {
+        return found->second;
+    }
+    if (!create) {
+        return nullptr;
+    }
+    m_owned.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[TILE_BYTES]()));
+    m_tiles[key(x, y)] = m_owned.back().get();
+    return m_owned.back().get();
+}
+
+void StaticMap::moveTo(double x, double y) {
+    const int64_t tileX = floorDiv(static_cast<int64_t>(std::floor(x * m_inverse)), TILE_CELLS) - WINDOW_TILES / 2;
+    const int64_t tileY = floorDiv(static_cast<int64_t>(std::floor(y * m_inverse)), TILE_CELLS) - WINDOW_TILES / 2;
+    if (tileX * TILE_CELLS != m_windowX || tileY * TILE_CELLS != m_windowY) {
+        m_windowX = tileX * TILE_CELLS;
+        m_windowY = tileY * TILE_CELLS;
+        updateWindow();
+    }
+}
+
+void StaticMap::updateWindow() {
+    const int32_t tileX = static_cast<int32_t>(m_windowX / TILE_CELLS);
+    const int32_t tileY = static_cast<int32_t>(m_windowY / TILE_CELLS);
+    for (uint32_t ty = 0; ty < WINDOW_TILES; ty++) {
+        for (uint32_t tx = 0; tx < WINDOW_TILES; tx++) {
+            m_window[ty * WINDOW_TILES + tx] = tile(tileX + tx, tileY + ty, false);
+        }
+    }
+}
+
+void StaticMap::observe(double x, double y) {
+    const int64_t cx = static_cast<int64_t>(std::floor(x * m_inverse));
+    const int64_t cy = static_cast<int64_t>(std::floor(y * m_inverse));
+    m_observed.push_back(key(static_cast<int32_t>(cx), static_cast<int32_t>(cy)));
+}
+
+void StaticMap::endFrame() {
+    std::sort(m_observed.begin(), m_observed.end());
+    m_observed.erase(std::unique(m_observed.begin(), m_observed.end()), m_observed.end());
+    bool created = false;
+    for (int64_t cell : m_observed) {
+        const int32_t cx = static_cast<int32_t>(cell >> 32);
+        const int32_t cy = static_cast<int32_t>(cell & 0xffffffff);
+        const size_t before = m_tiles.size();
+        uint8_t *cells = tile(static_cast<int32_t>(floorDiv(cx, TILE_CELLS)), static_cast<int32_t>(floorDiv(cy, TILE_CELLS)), true);
+        created |= m_tiles.size() != before;
+        uint8_t &evidence = cells[(cy - floorDiv(cy, TILE_CELLS) * TILE_CELLS) * TILE_CELLS + (cx - floorDiv(cx, TILE_CELLS) * TILE_CELLS)];
+        if (evidence < 255) {
+            evidence++;
+        }
+    }
+    m_observed.clear();
+    if (created) {
+        updateWindow();
+    }
+}
@@ -0,0 +1,431 @@
+#include "SweepArchive.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+
+// quotients from here on are sent as an escape and the raw residual
+static const uint32_t RICE_ESCAPE = 24;
+// the residual statistics are halved at this count to follow changes in the scene
+static const uint32_t RICE_RESET = 64;
+
+namespace {
+
+/**
+ * Residual statistics of one ring, as in the adaptive Golomb coding of JPEG-LS.
+ */
+struct RiceContext {
+    uint32_t sum = 16;
+    uint32_t count = 1;
+
+    uint32_t parameter() const {
+        uint32_t k = 0;
+        while ((count << k) < sum && k < 15) {
+            k++;
+        }
+        return k;
+    }
+
+    void update(uint32_t value) {
+        sum += value;
+        if (++count == RICE_RESET) {
+            sum >>= 1;
+            count >>= 1;
+        }
+    }
+};
+
+class BitWriter {
+public:
+    explicit BitWriter(std::string &out) : m_out(out), m_bits(0), m_count(0) {}
+
+    // count <= 32
+    void put(uint32_t value, uint32_t count) {
+        m_bits |= static_cast<uint64_t>(value) << m_count;
+        m_count += count;
+        while (m_count >= 8) {
+            m_out.push_back(static_cast<char>(m_bits & 0xff));
+            m_bits >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    void flush() {
+        if (m_count > 0) {
+            m_out.push_back(static_cast<char>(m_bits & 0xff));
+        }
+        m_bits = 0;
+        m_count = 0;
+    }
+
+private:
+    std::string &m_out;
+    uint64_t m_bits;
+    uint32_t m_count;
+};
+
+class BitReader {
+public:
+    BitReader(const char *data, size_t size) :
+            m_data(reinterpret_cast<const uint8_t *>(data)), m_end(m_data + size), m_bits(0), m_count(0), m_overrun(0) {}
+
+    void refill() {
+        while (m_count <= 56) {
+            if (m_data < m_end) {
+                m_bits |= static_cast<uint64_t>(*m_data++) << m_count;
+            } else {
+                m_overrun += 8;
+            }
+            m_count += 8;
+        }
+    }
+
+    // count <= 32, after refill()
+    uint32_t get(uint32_t count) {
+        const uint32_t value = static_cast<uint32_t>(m_bits & ((1ull << count) - 1));
+        m_bits >>= count;
+        m_count -= count;
+        return value;
+    }
+
+    // number of consecutive ones, at most limit, after refill()
+    uint32_t ones(uint32_t limit) {
+        const uint32_t count = __builtin_ctzll(~m_bits | (1ull << limit));
+        m_bits >>= count;
+        m_count -= count;
+        return count;
+    }
+
+    bool overrun() const {
+        // the zero bits appended past the end must not have been consumed
+        return m_overrun > m_count;
+    }
+
+private:
+    const uint8_t *m_data;
+    const uint8_t *m_end;
+    uint64_t m_bits;
+    uint32_t m_count;
+    uint32_t m_overrun;
+};
+
+inline uint16_t predict(const uint16_t *distances, uint32_t column, uint32_t layer, uint32_t layers) {
+    if (column == 0) {
+        return layer == 0 ? 0 : distances[layer - 1];
+    }
+    const uint16_t *previous = distances - layers;
+    if (layer == 0) {
+        return previous[0];
+    }
+    // median edge detector
+    const int a = distances[layer - 1];
+    const int b = previous[layer];
+    const int c = previous[layer - 1];
+    if (c >= std::max(a, b)) {
+        return static_cast<uint16_t>(std::min(a, b));
+    }
+    if (c <= std::min(a, b)) {
+        return static_cast<uint16_t>(std::max(a, b));
+    }
+    return static_cast<uint16_t>(a + b - c);
+}
+
+}
+
+
+void RangeCodec::encode(const uint16_t *distances, uint32_t columns, uint32_t layers, std::string &out) {
+    std::vector<RiceContext> contexts(layers);
+    BitWriter writer(out);
+    for (uint32_t i = 0; i < columns; i++) {
+        const uint16_t *column = distances + i * layers;
+        for (uint32_t layer = 0; layer < layers; layer++) {
+            // residual modulo 2^16, zigzag mapped to small values around 0
+            const int16_t residual = static_cast<int16_t>(static_cast<uint16_t>(column[layer] - predict(column, i, layer, layers)));
+            const uint32_t value = static_cast<uint16_t>((residual << 1) ^ (residual >> 15));
+            const uint32_t k = contexts[layer].parameter();
+            const uint32_t quotient = value >> k;
+            if (quotient < RICE_ESCAPE) {
+                writer.put((1u << quotient) - 1, quotient + 1);
+                writer.put(value & ((1u << k) - 1), k);
+            } else {
+                writer.put((1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+                writer.put(value, 16);
+            }
+            contexts[layer].update(value);
+        }
+    }
+    writer.flush();
+}
+
+bool RangeCodec::decode(const char *data, size_t size, uint32_t columns, uint32_t layers, uint16_t *distances) {
+    std::vector<RiceContext> contexts(layers);
+    BitReader reader(data, size);
+    for (uint32_t i = 0; i < columns; i++) {
+        uint16_t *column = distances + i * layers;
+        for (uint32_t layer = 0; layer < layers; layer++) {
+            reader.refill();
+            const uint32_t k = contexts[layer].parameter();
+            const uint32_t quotient = reader.ones(RICE_ESCAPE);
+            uint32_t value;
+            if (quotient < RICE_ESCAPE) {
+                reader.get(1);
+                value = (quotient << k) | reader.get(k);
+            } else {
+                value = reader.get(16);
+            }
+            const int16_t residual = static_cast<int16_t>((value >> 1) ^ (0u - (value & 1)));
+            column[layer] = static_cast<uint16_t>(predict(column, i, layer, layers) + residual);
+            contexts[layer].update(value);
+        }
+    }
+    return !reader.overrun();
+}
+
+
+SweepArchiveWriter::SweepArchiveWriter(const std::string &path) :
+        m_file(path, std::ios::out | std::ios::binary | std::ios::trunc), m_index(), m_offset(0), m_payload(), m_poses(),
+        m_queue(), m_spare(), m_mutex(), m_wake(), m_closing(false), m_dropped(0), m_thread() {
+    if (!m_file.good()) {
+        std::cerr << "Sweep archive " << path << " could not be created" << std::endl;
+        return;
+    }
+    ArchiveHeader header;
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.reserved = 0;
+    m_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    m_offset = sizeof(header);
+    m_thread = std::thread(&SweepArchiveWriter::run, this);
+}
+
+SweepArchiveWriter::~SweepArchiveWriter() {
+    close();
+}
+
+bool SweepArchiveWriter::isOpen() const {
+    return m_thread.joinable();
+}
+
+void SweepArchiveWriter::addPose(const Pose &pose) {
+    m_poses.push_back(pose);
+}
+
+void SweepArchiveWriter::addSweep(const Sweep &sweep) {
+    Entry entry;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_thread.joinable()) {
+            return;
+        }
+        if (m_queue.size() >= QUEUE_CAPACITY) {
+            // the poses are kept for the next sweep
+            m_dropped++;
+            return;
+        }
+        if (!m_spare.empty()) {
+            entry = std::move(m_spare.back());
+            m_spare.pop_back();
+        }
+    }
+    entry.sweep = sweep;
+    entry.distances.assign(sweep.distances, sweep.distances + sweep.columns * 16);
+    entry.poses.swap(m_poses);
+    m_poses.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(entry));
+    }
+    m_wake.notify_one();
+}
+
+uint64_t SweepArchiveWriter::dropped() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+void SweepArchiveWriter::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [this] { return !m_queue.empty() || m_closing; });
+        if (m_queue.empty()) {
+            break;
+        }
+        Entry entry = std::move(m_queue.front());
+        m_queue.pop_front();
+        lock.unlock();
+        writeFrame(entry);
+        lock.lock();
+        m_spare.push_back(std::move(entry));
+    }
+}
+
+void SweepArchiveWriter::writeFrame(const Entry &entry) {
+    m_payload.clear();
+    RangeCodec::encode(entry.distances.data(), entry.sweep.columns, 16, m_payload);
+
+    ArchiveFrame frame;
+    frame.magic = ARCHIVE_FRAME_MAGIC;
+    frame.sensor = static_cast<uint16_t>(entry.sweep.sensor);
+    frame.layers = 16;
+    frame.timestamp = entry.sweep.timestamp;
+    frame.startAzimuth = entry.sweep.startAzimuth;
+    frame.endAzimuth = entry.sweep.endAzimuth;
+    frame.columns = entry.sweep.columns;
+    frame.poseCount = entry.poses.size();
+    frame.payloadBytes = m_payload.size();
+    frame.reserved = 0;
+
+    m_file.write(reinterpret_cast<const char *>(&frame), sizeof(frame));
+    m_file.write(reinterpret_cast<const char *>(entry.poses.data()), entry.poses.size() * sizeof(Pose));
+    m_file.write(m_payload.data(), m_payload.size());
+
+    ArchiveIndexEntry index;
+    index.timestamp = frame.timestamp;
+    index.offset = m_offset;
+    m_index.push_back(index);
+    m_offset += sizeof(frame) + entry.poses.size() * sizeof(Pose) + m_payload.size();
+}
+
+void SweepArchiveWriter::close() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+
+    ArchiveTrailer trailer;
+    trailer.indexOffset = m_offset;
+    trailer.count = m_index.size();
+    trailer.magic = ARCHIVE_INDEX_MAGIC;
+    trailer.reserved = 0;
+    m_file.write(reinterpret_cast<const char *>(m_index.data()), m_index.size() * sizeof(ArchiveIndexEntry));
+    m_file.write(reinterpret_cast<const char *>(&trailer), sizeof(trailer));
+    m_file.close();
+    if (m_dropped > 0) {
+        std::cerr << "Sweep archive dropped " << m_dropped << " sweeps" << std::endl;
+    }
+}
+
+
+SweepArchiveReader::SweepArchiveReader(const std::string &path) :
+        m_file(path, std::ios::in | std::ios::binary), m_index(), m_frame(0), m_sweep(), m_poses(), m_distances(), m_payload() {
+    ArchiveHeader header;
+    if (!m_file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != ARCHIVE_MAGIC ||
+        header.version != ARCHIVE_VERSION) {
+        m_file.close();
+        return;
+    }
+    if (!readIndex()) {
+        scanFrames();
+    }
+}
+
+bool SweepArchiveReader::isArchive(const std::string &path) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    ArchiveHeader header;
+    return file.read(reinterpret_cast<char *>(&header), sizeof(header)) && header.magic == ARCHIVE_MAGIC;
+}
+
+bool SweepArchiveReader::readIndex() {
+    m_file.seekg(0, std::ios::end);
+    const uint64_t size = m_file.tellg();
+    if (size < sizeof(ArchiveHeader) + sizeof(ArchiveTrailer)) {
+        m_file.clear();
+        return false;
+    }
+    ArchiveTrailer trailer;
+    m_file.seekg(size - sizeof(trailer));
+    if (!m_file.read(reinterpret_cast<char *>(&trailer), sizeof(trailer)) || trailer.magic != ARCHIVE_INDEX_MAGIC ||
+        trailer.indexOffset + trailer.count * sizeof(ArchiveIndexEntry) + sizeof(trailer) != size) {
+        m_file.clear();
+        return false;
+    }
+    m_index.resize(trailer.count);
+    m_file.seekg(trailer.indexOffset);
+    if (!m_file.read(reinterpret_cast<char *>(m_index.data()), trailer.count * sizeof(ArchiveIndexEntry))) {
+        m_file.clear();
+        m_index.clear();
+        return false;
+    }
+    return true;
+}
+
+void SweepArchiveReader::scanFrames() {
+    m_file.seekg(0, std::ios::end);
+    const uint64_t size = m_file.tellg();
+    uint64_t offset = sizeof(ArchiveHeader);
+    ArchiveFrame frame;
+    while (offset + sizeof(frame) <= size) {
+        m_file.seekg(offset);
+        if (!m_file.read(reinterpret_cast<char *>(&frame), sizeof(frame)) || frame.magic != ARCHIVE_FRAME_MAGIC) {
+            break;
+        }
+        const uint64_t end = offset + sizeof(frame) + frame.poseCount * sizeof(Pose) + frame.payloadBytes;
+        if (end > size) {
+            break;
+        }
+        ArchiveIndexEntry entry;
+        entry.timestamp = frame.timestamp;
+        entry.offset = offset;
+        m_index.push_back(entry);
+        offset = end;
+    }
+    m_file.clear();
+    std::cerr << "Sweep archive has no index, found " << m_index.size() << " frames" << std::endl;
+}
+
+bool SweepArchiveReader::isOpen() const {
+    return m_file.is_open();
+}
+
+uint64_t SweepArchiveReader::frameCount() const {
+    return m_index.size();
+}
+
+bool SweepArchiveReader::seek(int64_t timestamp) {
+    auto entry = std::lower_bound(m_index.begin(), m_index.end(), timestamp,
+                                  [](const ArchiveIndexEntry &e, int64_t t) { return e.timestamp < t; });
+    m_frame = entry - m_index.begin();
+    return entry != m_index.end();
+}
+
+bool SweepArchiveReader::next() {
+    if (!m_file.is_open() || m_frame >= m_index.size()) {
+        return false;
+    }
+    ArchiveFrame frame;
+    m_file.seekg(m_index[m_frame].offset);
+    if (!m_file.read(reinterpret_cast<char *>(&frame), sizeof(frame)) || frame.magic != ARCHIVE_FRAME_MAGIC || frame.layers != 16 ||
+        frame.columns > 2000) {
+        return false;
+    }
+    m_poses.resize(frame.poseCount);
+    m_payload.resize(frame.payloadBytes);
+    m_distances.resize(frame.columns * frame.layers);
+    if (!m_file.read(reinterpret_cast<char *>(m_poses.data()), frame.poseCount * sizeof(Pose)) ||
+        !m_file.read(m_payload.data(), frame.payloadBytes) ||
+        !RangeCodec::decode(m_payload.data(), m_payload.size(), frame.columns, frame.layers, m_distances.data())) {
+        return false;
+    }
+
+    m_sweep.timestamp = frame.timestamp;
+    m_sweep.startAzimuth = frame.startAzimuth;
+    m_sweep.endAzimuth = frame.endAzimuth;
+    m_sweep.distances = m_distances.data();
+    m_sweep.columns = frame.columns;
+    m_sweep.sensor = frame.sensor;
+    m_frame++;
+    return true;
+}
+
+const Sweep &SweepArchiveReader::sweep() const {
+    return m_sweep;
+}
+
+const std::vector<Pose> &SweepArchiveReader::poses() const {
+    return m_poses;
+}
@@ -0,0 +1,192 @@
+#include "TaskScheduler.h"
+#include <algorithm>
+
+
+const uint32_t TaskScheduler::EXTERNAL_QUEUES;
+
+// attempts to find a task before an idle worker goes to sleep
+static const uint32_t IDLE_SPINS = 64;
+
+// queue of the calling thread, valid while the generation matches the scheduler's
+static thread_local uint32_t t_queue = 0;
+static thread_local uint32_t t_generation = 0;
+
+
+TaskScheduler &TaskScheduler::instance() {
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+TaskScheduler::TaskScheduler() :
+        m_queues(), m_workers(), m_setup(), m_generation(0), m_externalThreads(0), m_queued(0), m_sleeping(0), m_steals(0), m_stopping(false) {
+    const uint32_t cores = std::thread::hardware_concurrency();
+    start(cores > 1 ? cores - 1 : 0);
+}
+
+TaskScheduler::~TaskScheduler() {
+    stop();
+}
+
+void TaskScheduler::setWorkerCount(uint32_t workers) {
+    if (workers != m_workers.size()) {
+        stop();
+        start(workers);
+    }
+}
+
+uint32_t TaskScheduler::workerCount() const {
+    return m_workers.size();
+}
+
+void TaskScheduler::setWorkerSetup(const std::function<void(uint32_t)> &setup) {
+    const uint32_t workers = m_workers.size();
+    stop();
+    m_setup = setup;
+    start(workers);
+}
+
+uint64_t TaskScheduler::steals() const {
+    return m_steals.load(std::memory_order_relaxed);
+}
+
+void TaskScheduler::start(uint32_t workers) {
+    m_queues.clear();
+    for (uint32_t i = 0; i < workers + EXTERNAL_QUEUES; i++) {
+        m_queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    m_stopping = false;
+    m_externalThreads = 0;
+    m_generation++;
+    for (uint32_t i = 0; i < workers; i++) {
+        m_workers.push_back(std::thread(&TaskScheduler::run, this, i));
+    }
+}
+
+void TaskScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+uint32_t TaskScheduler::queueOfThisThread() {
+    const uint32_t generation = m_generation.load();
+    if (t_generation != generation) {
+        t_generation = generation;
+        t_queue = m_workers.size() + m_externalThreads.fetch_add(1) % EXTERNAL_QUEUES;
+    }
+    return t_queue;
+}
+
+void TaskScheduler::parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)> &task) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<uint32_t>(grain, 1);
+    if (m_workers.empty() || count <= grain) {
+        task(0, count);
+        return;
+    }
+
+    const uint32_t chunks = (count + grain - 1) / grain;
+    std::atomic<uint32_t> pending(chunks);
+    const uint32_t own = queueOfThisThread();
+    {
+        // the calling thread works from the back, thieves start at the front
+        std::lock_guard<std::mutex> lock(m_queues[own]->mutex);
+        for (uint32_t begin = 0; begin < count; begin += grain) {
+            Task chunk;
+            chunk.function = &task;
+            chunk.begin = begin;
+            chunk.end = std::min(begin + grain, count);
+            chunk.pending = &pending;
+            m_queues[own]->tasks.push_back(chunk);
+        }
+    }
+    m_queued.fetch_add(chunks);
+    if (m_sleeping.load() > 0) {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+        }
+        m_wake.notify_all();
+    }
+
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (!runOne(own)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool TaskScheduler::runOne(uint32_t own) {
+    if (m_queued.load() == 0) {
+        return false;
+    }
+    Task task;
+    bool found = false;
+    {
+        Queue &queue = *m_queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            found = true;
+        }
+    }
+    for (uint32_t k = 1; k < m_queues.size() && !found; k++) {
+        Queue &queue = *m_queues[(own + k) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            found = true;
+            m_steals.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    m_queued.fetch_sub(1);
+    (*task.function)(task.begin, task.end);
+    task.pending->fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void TaskScheduler::run(uint32_t worker) {
+    t_queue = worker;
+    t_generation = m_generation.load();
+    if (m_setup) {
+        m_setup(worker);
+    }
+    while (true) {
+        bool ran = false;
+        for (uint32_t spin = 0; spin < IDLE_SPINS && !ran; spin++) {
+            ran = runOne(worker);
+            if (!ran) {
+                std::this_thread::yield();
+            }
+        }
+        if (ran) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        if (m_stopping) {
+            return;
+        }
+        // parallelFor() checks for sleepers after queueing, so no task is missed
+        m_sleeping++;
+        m_wake.wait(lock, [this]() {
+            return m_stopping || m_queued.load() > 0;
+        });
+        m_sleeping--;
+        if (m_stopping) {
+            return;
+        }
+    }
+}
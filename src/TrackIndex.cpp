@@ -0,0 +1,207 @@
+#include "TrackIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "Utils.h"
+
+
+// 64 x 64 cells of 4 m, 128 m around the ego position
+static const int32_t GRID_CELLS = 64;
+static const float CELL_SIZE = 4;
+static const float GRID_MIN = -GRID_CELLS * CELL_SIZE / 2;
+
+
+TrackIndex::TrackIndex() : m_added(), m_entries(), m_start(GRID_CELLS * GRID_CELLS + 1, 0) {}
+
+void TrackIndex::clear() {
+    m_added.clear();
+    m_entries.clear();
+    std::fill(m_start.begin(), m_start.end(), 0);
+}
+
+void TrackIndex::add(uint32_t id, float x, float y) {
+    Entry entry;
+    entry.id = id;
+    entry.x = x;
+    entry.y = y;
+    m_added.push_back(entry);
+}
+
+void TrackIndex::build() {
+    // counting sort by cell
+    std::fill(m_start.begin(), m_start.end(), 0);
+    for (auto &entry : m_added) {
+        m_start[row(entry.y) * GRID_CELLS + column(entry.x) + 1]++;
+    }
+    for (uint32_t c = 0; c < GRID_CELLS * GRID_CELLS; c++) {
+        m_start[c + 1] += m_start[c];
+    }
+    m_entries.resize(m_added.size());
+    for (auto &entry : m_added) {
+        // m_start[c] runs up to the start of cell c + 1 and is restored below
+        m_entries[m_start[row(entry.y) * GRID_CELLS + column(entry.x)]++] = entry;
+    }
+    for (uint32_t c = GRID_CELLS * GRID_CELLS; c > 0; c--) {
+        m_start[c] = m_start[c - 1];
+    }
+    m_start[0] = 0;
+}
+
+void TrackIndex::build(const ObstacleFrameReader &frame) {
+    m_added.clear();
+    for (uint32_t i = 0; i < frame.size(); i++) {
+        add(i, frame[i].x, frame[i].y);
+    }
+    build();
+}
+
+uint32_t TrackIndex::size() const {
+    return m_entries.size();
+}
+
+int32_t TrackIndex::column(float x) const {
+    const float cell = std::floor((x - GRID_MIN) / CELL_SIZE);
+    // also catches NaN
+    if (!(cell >= 0)) {
+        return 0;
+    }
+    return static_cast<int32_t>(std::min<float>(cell, GRID_CELLS - 1));
+}
+
+int32_t TrackIndex::row(float y) const {
+    const float cell = std::floor((y - GRID_MIN) / CELL_SIZE);
+    // also catches NaN
+    if (!(cell >= 0)) {
+        return 0;
+    }
+    return static_cast<int32_t>(std::min<float>(cell, GRID_CELLS - 1));
+}
+
+template<typename Visit>
+void TrackIndex::visitCells(int32_t firstColumn, int32_t lastColumn, int32_t firstRow, int32_t lastRow, Visit visit) const {
+    for (int32_t r = firstRow; r <= lastRow; r++) {
+        // the cells of a row are contiguous
+        const uint32_t begin = m_start[r * GRID_CELLS + firstColumn];
+        const uint32_t end = m_start[r * GRID_CELLS + lastColumn + 1];
+        for (uint32_t e = begin; e < end; e++) {
+            visit(m_entries[e]);
+        }
+    }
+}
+
+void TrackIndex::radius(float x, float y, float radius, std::vector<uint32_t> &ids) const {
+    ids.clear();
+    const float squared = radius * radius;
+    visitCells(column(x - radius), column(x + radius), row(y - radius), row(y + radius), [&](const Entry &entry) {
+        const float dx = entry.x - x;
+        const float dy = entry.y - y;
+        if (dx * dx + dy * dy < squared) {
+            ids.push_back(entry.id);
+        }
+    });
+    std::sort(ids.begin(), ids.end());
+}
+
+void TrackIndex::corridor(float x, float y, float heading, float length, float halfWidth, std::vector<uint32_t> &ids) const {
+    ids.clear();
+    const float s = static_cast<float>(std::sin(utils::deg2rad(heading)));
+    const float c = static_cast<float>(std::cos(utils::deg2rad(heading)));
+    // bounding box of the rectangle
+    const float endX = x + length * s;
+    const float endY = y + length * c;
+    const float marginX = std::fabs(halfWidth * c);
+    const float marginY = std::fabs(halfWidth * s);
+    visitCells(column(std::min(x, endX) - marginX), column(std::max(x, endX) + marginX),
+               row(std::min(y, endY) - marginY), row(std::max(y, endY) + marginY), [&](const Entry &entry) {
+        const float dx = entry.x - x;
+        const float dy = entry.y - y;
+        const float along = dx * s + dy * c;
+        const float across = dx * c - dy * s;
+        if (along >= 0 && along <= length && std::fabs(across) <= halfWidth) {
+            ids.push_back(entry.id);
+        }
+    });
+    std::sort(ids.begin(), ids.end());
+}
+
+void TrackIndex::nearest(float x, float y, uint32_t k, std::vector<uint32_t> &ids) const {
+    ids.clear();
+    if (k == 0 || m_entries.empty()) {
+        return;
+    }
+    auto distance = [&](uint32_t e) {
+        const float dx = m_entries[e].x - x;
+        const float dy = m_entries[e].y - y;
+        return dx * dx + dy * dy;
+    };
+    auto closer = [&](uint32_t a, uint32_t b) {
+        const float da = distance(a);
+        const float db = distance(b);
+        return da < db || (da == db && m_entries[a].id < m_entries[b].id);
+    };
+    // ids holds indices of m_entries as a heap with the farthest on top until the end
+    auto offer = [&](const Entry &entry) {
+        const uint32_t e = &entry - m_entries.data();
+        if (ids.size() < k) {
+            ids.push_back(e);
+            std::push_heap(ids.begin(), ids.end(), closer);
+        } else if (closer(e, ids.front())) {
+            std::pop_heap(ids.begin(), ids.end(), closer);
+            ids.back() = e;
+            std::push_heap(ids.begin(), ids.end(), closer);
+        }
+    };
+
+    // rings of cells around the cell of x, y until no unvisited cell can be closer
+    const int32_t cx = column(x);
+    const int32_t cy = row(y);
+    for (int32_t ring = 0; ; ring++) {
+        const int32_t firstColumn = std::max(cx - ring, 0);
+        const int32_t lastColumn = std::min(cx + ring, GRID_CELLS - 1);
+        const int32_t firstRow = std::max(cy - ring, 0);
+        const int32_t lastRow = std::min(cy + ring, GRID_CELLS - 1);
+        for (int32_t r = firstRow; r <= lastRow; r++) {
+            if (r == cy - ring || r == cy + ring) {
+                visitCells(firstColumn, lastColumn, r, r, offer);
+            } else {
+                if (cx - ring >= 0) {
+                    visitCells(cx - ring, cx - ring, r, r, offer);
+                }
+                if (ring > 0 && cx + ring < GRID_CELLS) {
+                    visitCells(cx + ring, cx + ring, r, r, offer);
+                }
+            }
+        }
+
+        const bool left = firstColumn > 0;
+        const bool right = lastColumn < GRID_CELLS - 1;
+        const bool bottom = firstRow > 0;
+        const bool top = lastRow < GRID_CELLS - 1;
+        if (!left && !right && !bottom && !top) {
+            break;
+        }
+        // unvisited tracks lie outside of the visited cells, the border cells extend
+        // to infinity
+        float bound = std::numeric_limits<float>::max();
+        if (left) {
+            bound = std::min(bound, x - (GRID_MIN + firstColumn * CELL_SIZE));
+        }
+        if (right) {
+            bound = std::min(bound, GRID_MIN + (lastColumn + 1) * CELL_SIZE - x);
+        }
+        if (bottom) {
+            bound = std::min(bound, y - (GRID_MIN + firstRow * CELL_SIZE));
+        }
+        if (top) {
+            bound = std::min(bound, GRID_MIN + (lastRow + 1) * CELL_SIZE - y);
+        }
+        if (ids.size() == k && bound > 0 && distance(ids.front()) < bound * bound) {
+            break;
+        }
+    }
+
+    std::sort_heap(ids.begin(), ids.end(), closer);
+    for (auto &e : ids) {
+        e = m_entries[e].id;
+    }
+}
@@ -1,5 +1,7 @@
 #include "Utils.h"
-#include "Cluster.h"
+#include <cctype>
+#include <cerrno>
+#include <sstream>
 #include "Point.h"
 
 namespace utils {
@@ -113,6 +115,30 @@ namespace utils {
             return a;
         return b;
     }
+
+    std::vector<uint64_t> parseIdList(const std::string &list, const std::string &name) {
+        std::vector<uint64_t> ids;
+        std::stringstream entries(list);
+        std::string entry;
+        while (std::getline(entries, entry, ',')) {
+            size_t first = entry.find_first_not_of(" \t");
+            if (first == std::string::npos) {
+                continue;
+            }
+            size_t last = entry.find_last_not_of(" \t");
+            entry = entry.substr(first, last - first + 1);
+            // strtoull would accept a sign and stop at the first bad character
+            char *end = nullptr;
+            errno = 0;
+            const uint64_t id = std::isdigit(static_cast<unsigned char>(entry[0])) ? std::strtoull(entry.c_str(), &end, 10) : 0;
+            if (end == nullptr || *end != '\0' || errno == ERANGE) {
+                std::cerr << "Skipping \"" << entry << "\" in " << name << ", not an unsigned number" << std::endl;
+                continue;
+            }
+            ids.push_back(id);
+        }
+        return ids;
+    }
 }
 
 
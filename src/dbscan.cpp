@@ -1,23 +1,22 @@
 #include "dbscan.h"
-#include <opendavinci/odcore/base/module/DataTriggeredConferenceClientModule.h>
-#include "opendavinci/odcore/wrapper/half_float.h"
-#include <opencv2/core/core.hpp>
-#include <chrono>
+#include <algorithm>
 
 
 void DbScan::getClusters(std::vector<Cluster> &clusters) {
-    for (uint32_t angle = 0; angle < m_cloudSize; angle++) {
+    // decimated columns contribute proportionally fewer neighbours
+    const uint32_t minPts = m_minPts / m_stride;
+    for (uint32_t angle = 0; angle < m_cloudSize; angle += m_stride) {
         for (int index = 0; index < 16; index++) {
             Point *point = &m_points[angle][index];
             if (!point->isVisited() && !point->isClustered()) {
                 point->setVisited(true);
-                auto neighbors = std::vector<Point *>();
-                regionQuery(neighbors, point);
-                if (neighbors.size() > m_minPts) {
-                    clusters.push_back(Cluster());
+                m_neighbors.clear();
+                regionQuery(m_neighbors, point);
+                if (m_neighbors.size() > minPts) {
+                    clusters.push_back(Cluster(m_neighbors.get_allocator()));
                     clusters.back().m_cluster.push_back(point);
                     point->setClustered(true);
-                    expandCluster(neighbors, clusters.back());
+                    expandCluster(m_neighbors, clusters.back());
                 }
             }
         }
@@ -25,54 +24,59 @@ void DbScan::getClusters(std::vector<Cluster> &clusters) {
 }
 
 
-void DbScan::regionQuery(std::vector<Point *> &neighbors, Point *point) {
-    int didx = 5;
-    int i = point->getIndex();
-    int neg_idx = i - didx;
-    int pos_idx = i + 1 + didx - m_cloudSize;
+void DbScan::setWindow(int window) {
+    m_window = window;
+}
 
+void DbScan::setColumnStride(int stride) {
+    m_stride = std::max(1, stride);
+}
 
-    for (uint32_t k = m_cloudSize + neg_idx; k < m_cloudSize; k++) {
-        for (int l = 0; l < 16; l++) {
-            if (!m_points[k][l].isGround() && point->get2Distance(m_points[k][l]) < m_eps) {
-                neighbors.push_back(&m_points[k][l]);
-            }
+void DbScan::setArena(FrameArena *arena) {
+    m_neighbors = PointList(ArenaAllocator<Point *>(arena));
+    m_collection = PointList(ArenaAllocator<Point *>(arena));
+}
 
-        }
-    }
 
-    for (int k = 0; k < pos_idx; k++) {
-        for (int l = 0; l < 16; l++) {
-            if (!m_points[k][l].isGround() && point->get2Distance(m_points[k][l]) < m_eps) {
-                neighbors.push_back(&m_points[k][l]);
-            }
+void DbScan::regionQuery(PointList &neighbors, Point *point) {
+    int i = point->getIndex();
+    int neg_idx = i - m_window;
+    int pos_idx = i + 1 + m_window - m_cloudSize;
 
-        }
+    // the window wraps around at both ends of the sweep
+    if (neg_idx < 0) {
+        queryColumns(neighbors, point, m_cloudSize + neg_idx, m_cloudSize);
     }
+    if (pos_idx > 0) {
+        queryColumns(neighbors, point, 0, pos_idx);
+    }
+    queryColumns(neighbors, point, std::max(0, neg_idx), std::min(i + 1 + m_window, (int) m_cloudSize));
+}
 
-    for (int k = std::max(0, neg_idx); k < std::min(i + 1 + didx, (int) m_cloudSize); k++) {
+
+void DbScan::queryColumns(PointList &neighbors, Point *point, int begin, int end) {
+    for (int k = (begin + m_stride - 1) / m_stride * m_stride; k < end; k += m_stride) {
         for (int l = 0; l < 16; l++) {
-            if (!m_points[k][l].isGround() && point->get2Distance(m_points[k][l]) < m_eps) {
+            if (!m_points[k][l].isGround() && !m_points[k][l].isOutsideRoi() && !m_points[k][l].isTracked() && !m_points[k][l].isStatic() && point->get2Distance(m_points[k][l]) < m_eps) {
                 neighbors.push_back(&m_points[k][l]);
             }
 
         }
     }
-
 }
 
 
-void DbScan::expandCluster(std::vector<Point *> &neighbors, Cluster &cluster) {
+void DbScan::expandCluster(PointList &neighbors, Cluster &cluster) {
     while (!neighbors.empty()) {
         Point *point = neighbors.back();
         neighbors.pop_back();
 
         if (!point->isVisited()) {
             point->setVisited(true);
-            auto collection = std::vector<Point *>();
-            regionQuery(collection, point);
-            if (collection.size() > m_minPts) {
-                neighbors.insert(neighbors.end(), collection.begin(), collection.end());
+            m_collection.clear();
+            regionQuery(m_collection, point);
+            if (m_collection.size() > m_minPts / m_stride) {
+                neighbors.insert(neighbors.end(), m_collection.begin(), m_collection.end());
             }
         }
         if (!point->isClustered()) {
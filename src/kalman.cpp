@@ -82,8 +82,13 @@ void Kalman::update(double x, double y, double theta, double speed, double yaw,
         theta = z2_3;
 
 
+    // the state is still in the frame of the last sweep; the points, and with them the
+    // measurement, move against the ego motion
+    m_x[0] -= movement_x;
+    m_x[1] -= movement_y;
+
     Eigen::Matrix<double, 5, 1> Z;
-    Z << x-movement_x, y-movement_y, theta, speed, yaw;
+    Z << x, y, theta, speed, yaw;
     // Measurement Function
 
     Eigen::Matrix<double, 5, 1> hx;
@@ -122,6 +127,4 @@ void Kalman::update(double x, double y, double theta, double speed, double yaw,
 
     // Update the error covariance
     m_P = (m_I - (K * JH)) * m_P;
-    m_x[0]+=movement_x;
-    m_x[1]+=movement_y;
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "opendavinci/odcore/data/Container.h"
+#include "opendavinci/odcore/data/TimeStamp.h"
+#include "opendavinci/generated/odcore/data/CompactPointCloud.h"
+#include "odvdapplanix/GeneratedHeaders_ODVDApplanix.h"
+#include "FlightRecorder.h"
+
+using namespace std;
+
+static odcore::data::TimeStamp toTimeStamp(int64_t timestamp) {
+    return odcore::data::TimeStamp(static_cast<int32_t>(timestamp / 1000000), static_cast<int32_t>(timestamp % 1000000));
+}
+
+/**
+ * Turns a flight record into a recording that pointcloud_cluster-replay reads.
+ *
+ * Poses are written as cartesian Grp1Data, flagged with the roll of the simulation, so
+ * the replay sees exactly the poses of the recorded run. Sweeps keep the sender stamp of
+ * their lidar; by default the stamp is the sensor index, or the n-th of the given stamps.
+ * Labels and tracks are only counted.
+ *
+ * Usage: pointcloud_cluster-extract <flight record> [recording] [sender stamps, e.g. 0,1]
+ */
+int32_t main(int32_t argc, char **argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <flight record> [recording] [sender stamps, e.g. 0,1]" << endl;
+        return 1;
+    }
+
+    FlightRecordReader reader(argv[1]);
+    if (!reader.isOpen()) {
+        cerr << "Could not open " << argv[1] << endl;
+        return 1;
+    }
+
+    fstream recording;
+    if (argc > 2) {
+        recording.open(argv[2], ios::out | ios::binary | ios::trunc);
+        if (!recording.good()) {
+            cerr << "Could not create " << argv[2] << endl;
+            return 1;
+        }
+    }
+
+    vector<uint32_t> stamps;
+    if (argc > 3) {
+        stringstream list(argv[3]);
+        string stamp;
+        while (getline(list, stamp, ',')) {
+            if (!stamp.empty()) {
+                stamps.push_back(stoul(stamp));
+            }
+        }
+    }
+
+    uint64_t counts[RECORD_TRACKS + 1] = {0, 0, 0, 0, 0};
+    int64_t first = 0, last = 0;
+    while (reader.next()) {
+        const FlightRecord &record = reader.record();
+        if (record.type <= RECORD_TRACKS) {
+            counts[record.type]++;
+        }
+        if (first == 0) {
+            first = record.timestamp;
+        }
+        last = std::max(last, record.timestamp);
+        if (!recording.is_open()) {
+            continue;
+        }
+
+        if (record.type == RECORD_POSE) {
+            Pose pose;
+            memcpy(&pose, reader.payload(), sizeof(Pose));
+            opendlv::core::sensors::applanix::Grp1Data imu;
+            imu.setLat(pose.x);
+            imu.setLon(pose.y);
+            imu.setHeading(pose.heading);
+            imu.setRoll(1234);
+            odcore::data::Container c(imu);
+            c.setSentTimeStamp(toTimeStamp(pose.timestamp));
+            recording << c;
+        } else if (record.type == RECORD_SWEEP) {
+            SweepRecord sweep;
+            memcpy(&sweep, reader.payload(), sizeof(SweepRecord));
+            odcore::data::CompactPointCloud cpc;
+            cpc.setStartAzimuth(sweep.startAzimuth);
+            cpc.setEndAzimuth(sweep.endAzimuth);
+            cpc.setEntriesPerAzimuth(sweep.layers);
+            cpc.setDistances(string(reader.payload() + sizeof(SweepRecord), sweep.columns * sweep.layers * sizeof(uint16_t)));
+            odcore::data::Container c(cpc);
+            c.setSentTimeStamp(toTimeStamp(record.timestamp));
+            c.setSenderStamp(record.sensor < stamps.size() ? stamps[record.sensor] : record.sensor);
+            recording << c;
+        }
+    }
+    recording.flush();
+
+    cout << "Recorded time [s]: " << (last - first) / 1000000.0 << endl;
+    cout << "Poses: " << counts[RECORD_POSE] << endl;
+    cout << "Sweeps: " << counts[RECORD_SWEEP] << endl;
+    cout << "Labels: " << counts[RECORD_LABELS] << endl;
+    cout << "Tracks: " << counts[RECORD_TRACKS] << endl;
+    return 0;
+}
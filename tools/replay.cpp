@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include "opendavinci/generated/odcore/data/CompactPointCloud.h"
+#include "PointcloudPipeline.h"
+#include "ContainerAdapter.h"
+#include "Utils.h"
+#include "SweepArchive.h"
+#include "StageTimer.h"
+#include "Logger.h"
+
+using namespace std;
+
+/**
+ * Reads the lidars from a configuration file of the module, i.e. the
+ * pointcloudclustering.lidars and pointcloudclustering.lidar.N.x/.y/.z/.yaw keys in
+ * "key = value" lines.
+ *
+ * @return False if the file cannot be read.
+ */
+static bool readSensors(const string &path, vector<uint32_t> &stamps, vector<Extrinsics> &sensors) {
+    ifstream file(path);
+    if (!file.good()) {
+        return false;
+    }
+    map<string, string> config;
+    string line;
+    while (getline(file, line)) {
+        const size_t equals = line.find('=');
+        if (line.empty() || line[0] == '#' || equals == string::npos) {
+            continue;
+        }
+        const string key = line.substr(0, equals);
+        const size_t first = key.find_first_not_of(" \t");
+        const size_t last = key.find_last_not_of(" \t");
+        if (first != string::npos) {
+            config[key.substr(first, last - first + 1)] = line.substr(equals + 1);
+        }
+    }
+    auto value = [&](const string &key) {
+        auto entry = config.find(key);
+        if (entry == config.end()) {
+            return 0.0;
+        }
+        char *end = nullptr;
+        const double number = strtod(entry->second.c_str(), &end);
+        if (end == entry->second.c_str() || entry->second.find_first_not_of(" \t\r", end - entry->second.c_str()) != string::npos) {
+            cerr << "Taking 0 for " << key << ", \"" << entry->second << "\" is not a number" << endl;
+            return 0.0;
+        }
+        return number;
+    };
+    for (uint64_t lidar : utils::parseIdList(config["pointcloudclustering.lidars"], "pointcloudclustering.lidars")) {
+        const string prefix = "pointcloudclustering.lidar." + to_string(lidar);
+        Extrinsics extrinsics;
+        extrinsics.x = value(prefix + ".x");
+        extrinsics.y = value(prefix + ".y");
+        extrinsics.z = value(prefix + ".z");
+        extrinsics.yaw = value(prefix + ".yaw");
+        stamps.push_back(static_cast<uint32_t>(lidar));
+        sensors.push_back(extrinsics);
+    }
+    return true;
+}
+
+/**
+ * Reads an OpenDaVINCI recording and feeds it into the pipeline.
+ *
+ * @param stamps Sender stamps of the lidars in the order of the pipeline's sensors,
+ * empty to take every sweep from the primary lidar.
+ */
+static void replayRecording(const string &path, const vector<uint32_t> &stamps, PointcloudPipeline &pipeline,
+                            const function<void(chrono::steady_clock::time_point)> &processed) {
+    fstream recording(path, ios::in | ios::binary);
+    if (!recording.good()) {
+        cerr << "Could not open " << path << endl;
+        return;
+    }
+    ContainerAdapter adapter;
+    adapter.setSensors(stamps);
+    bool firstSweep = true;
+    bool warned = false;
+    uint32_t firstStamp = 0;
+    while (recording.good()) {
+        odcore::data::Container c;
+        recording >> c;
+        if (!recording.good()) {
+            break;
+        }
+        if (stamps.empty() && !warned && c.getDataType() == odcore::data::CompactPointCloud::ID()) {
+            if (firstSweep) {
+                firstStamp = c.getSenderStamp();
+                firstSweep = false;
+            } else if (c.getSenderStamp() != firstStamp) {
+                cerr << "The recording has sweeps of sender stamps " << firstStamp << " and " << c.getSenderStamp()
+                     << ", they are all taken as the primary lidar without a lidar configuration" << endl;
+                warned = true;
+            }
+        }
+        // reading the container and containers that did not complete a frame are not
+        // part of the next frame
+        StageTimers::instance().beginFrame();
+        chrono::steady_clock::time_point frameBegin = chrono::steady_clock::now();
+        if (adapter.feed(c, pipeline)) {
+            processed(frameBegin);
+        }
+    }
+}
+
+/**
+ * Reads a sweep archive from start seconds after its first frame and feeds it into the
+ * pipeline.
+ */
+static void replayArchive(const string &path, double start, PointcloudPipeline &pipeline, const function<void(chrono::steady_clock::time_point)> &processed) {
+    SweepArchiveReader archive(path);
+    if (!archive.isOpen()) {
+        cerr << "Could not open " << path << endl;
+        return;
+    }
+    if (start > 0) {
+        if (!archive.next() || !archive.seek(archive.sweep().timestamp + static_cast<int64_t>(start * 1000000))) {
+            cerr << "The archive ends before " << start << " s" << endl;
+            return;
+        }
+    }
+    bool warned = false;
+    while (true) {
+        // reading is input I/O like reading a recording, neither decode nor frame time
+        if (!archive.next()) {
+            break;
+        }
+        if (archive.sweep().sensor >= pipeline.sensorCount() && !warned) {
+            cerr << "Dropping the sweeps of sensor " << archive.sweep().sensor << ", the lidar configuration has "
+                 << pipeline.sensorCount() << " lidars" << endl;
+            warned = true;
+        }
+        StageTimers::instance().beginFrame();
+        chrono::steady_clock::time_point frameBegin = chrono::steady_clock::now();
+        for (auto &pose : archive.poses()) {
+            pipeline.addPose(pose);
+        }
+        if (pipeline.process(archive.sweep())) {
+            processed(frameBegin);
+        }
+    }
+}
+
+// frames before the allocations are held against the ceiling
+static const uint64_t WARMUP_FRAMES = 20;
+
+// microseconds per unit of work of the budget steps, measured on a desktop CPU with 32
+// objects in the scene, see PointcloudPipeline::setBudgetCosts()
+static const double BUDGET_COSTS[FrameBudget::STEPS] = {0.011, 0.002, 1.0};
+
+/**
+ * Replays a recording or a sweep archive through the processing pipeline as fast as
+ * possible.
+ *
+ * Usage: pointcloud_cluster-replay <recording or archive> [budget in ms] [start in s]
+ * [allocation ceiling] [hardware counters 0/1] [wall clock budget 0/1] [configuration]
+ *
+ * The configuration is a configuration file of the module; its lidars are set up like
+ * in the module, see readSensors(). Without it there is a single lidar.
+ *
+ * The budget runs on a virtual clock with fixed costs per unit of work, so the same
+ * frames degrade on every machine; with the last argument it uses the wall clock like
+ * the module. With a ceiling, the replay fails if a frame after the warm-up allocates
+ * more often.
+ */
+int32_t main(int32_t argc, char **argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <recording or archive> [budget in ms] [start in s, archives only] [allocation ceiling] [hardware counters 0/1] [wall clock budget 0/1] [configuration]" << endl;
+        return 1;
+    }
+    const uint64_t allocationCeiling = argc > 4 ? stoull(argv[4]) : 0;
+    if (argc > 5 && stoi(argv[5]) != 0) {
+        StageTimers::instance().setCountingEvents(true);
+    }
+
+    PointcloudPipeline pipeline;
+    if (argc > 2) {
+        pipeline.setBudget(static_cast<int64_t>(stod(argv[2]) * 1000));
+    }
+    if (argc <= 6 || stoi(argv[6]) == 0) {
+        pipeline.setBudgetCosts(BUDGET_COSTS);
+    }
+    vector<uint32_t> stamps;
+    if (argc > 7) {
+        vector<Extrinsics> sensors;
+        if (!readSensors(argv[7], stamps, sensors)) {
+            cerr << "Could not open " << argv[7] << endl;
+            return 1;
+        }
+        if (!sensors.empty()) {
+            pipeline.setSensors(sensors);
+        }
+    }
+
+    uint64_t frames = 0;
+    int64_t firstTimestamp = 0;
+    int64_t lastTimestamp = 0;
+    uint64_t worstAllocations = 0;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    auto processed = [&](chrono::steady_clock::time_point frameBegin) {
+        StageTimers::instance().endFrame(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - frameBegin).count());
+        if (frames >= WARMUP_FRAMES) {
+            worstAllocations = max(worstAllocations, StageTimers::instance().frameAllocations());
+        }
+        lastTimestamp = pipeline.timestamp();
+        if (frames == 0) {
+            firstTimestamp = lastTimestamp;
+        }
+        frames++;
+    };
+    if (SweepArchiveReader::isArchive(argv[1])) {
+        replayArchive(argv[1], argc > 3 ? stod(argv[3]) : 0, pipeline, processed);
+    } else {
+        replayRecording(argv[1], stamps, pipeline, processed);
+    }
+    double seconds = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count() / 1000000.0;
+    double recorded = (lastTimestamp - firstTimestamp) / 1000000.0;
+
+    StageTimers::instance().report();
+    Logger::instance().flush();
+    cout << "Frames: " << frames << endl;
+    cout << "Wall time [s]: " << seconds << endl;
+    cout << "Frames per second: " << (seconds > 0 ? frames / seconds : 0) << endl;
+    cout << "Recorded time [s]: " << recorded << endl;
+    cout << "Faster than real time: " << (seconds > 0 ? recorded / seconds : 0) << endl;
+    cout << "Most allocations in a frame after " << WARMUP_FRAMES << " frames: " << worstAllocations << endl;
+    if (allocationCeiling > 0 && worstAllocations > allocationCeiling) {
+        cerr << "The allocations exceed the ceiling of " << allocationCeiling << endl;
+        return 1;
+    }
+    return 0;
+}